@@ -0,0 +1,239 @@
+#ifndef ADMISSION_CONTROLLER_HPP
+#define ADMISSION_CONTROLLER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief how the periodic tasks sharing a thread are prioritized, this decides which schedulability test is used
+ *
+ * rate monotonic gives fixed priorities, the higher the rate the higher the priority, which is what you get when
+ * several PeriodicSignals are polled in order of rate on one thread
+ *
+ * earliest deadline first always runs the task whose next tick is soonest, which is what you get from a deadline heap
+ * like TimerScheduler
+ */
+enum class SchedulingPolicy {
+    rate_monotonic,
+    earliest_deadline_first,
+};
+
+/**
+ * @brief checks whether a set of periodic tasks sharing one thread can all meet their deadlines before a new task is
+ * added, and rejects the task or lowers its rate if they can't
+ *
+ * @details every task has a rate and a worst case execution time (wcet), the wcet starts out as the declared value
+ * and grows whenever a longer execution is reported with @see record_execution_time, so the checks get more accurate
+ * the longer the process runs.
+ *
+ * for earliest deadline first the task set is schedulable exactly when the total utilization (sum of wcet * rate) is
+ * at most the utilization limit. For rate monotonic we first try the hyperbolic bound, the product of (u_i + 1) being
+ * at most 2 is enough to be schedulable, and if that's inconclusive we run response time analysis, which is exact for
+ * fixed priorities when every task's deadline is its next tick.
+ *
+ * the utilization limit (1.0 by default) leaves room for everything that isn't a registered task, eg 0.8 keeps 20%
+ * of the thread free.
+ *
+ * usage with a TimerScheduler:
+ *
+ *     auto result = admission_controller.try_admit("replication", 60, 0.002, 10);
+ *     if (result.outcome != AdmissionController::Outcome::rejected) {
+ *         scheduler.schedule_periodic(result.admitted_rate_hz, replicate);
+ *     }
+ */
+class AdmissionController {
+  public:
+    using TaskId = std::uint32_t;
+
+    enum class Outcome {
+        admitted,
+        // admitted at a lower rate than requested
+        downgraded,
+        rejected,
+    };
+
+    struct AdmissionResult {
+        Outcome outcome;
+        TaskId task_id;
+        int admitted_rate_hz;
+        // the utilization of the whole task set including the new task, or without it if it was rejected
+        double utilization;
+    };
+
+    struct Task {
+        TaskId id;
+        std::string name;
+        int rate_hz;
+        double declared_wcet_seconds;
+        double measured_wcet_seconds;
+
+        double get_wcet_seconds() const { return std::max(declared_wcet_seconds, measured_wcet_seconds); }
+        double get_period_seconds() const { return 1.0 / rate_hz; }
+        double get_utilization() const { return get_wcet_seconds() * rate_hz; }
+    };
+
+    explicit AdmissionController(SchedulingPolicy scheduling_policy, double utilization_limit = 1.0)
+        : scheduling_policy(scheduling_policy), utilization_limit(utilization_limit) {}
+
+    /**
+     * @brief admits the task if the task set stays schedulable, otherwise lowers its rate as far as minimum_rate_hz
+     * looking for one that fits, and rejects it if there is none
+     *
+     * @param minimum_rate_hz the lowest rate the task is still useful at, 0 or anything above rate_hz means the rate
+     * can't be lowered
+     *
+     * @note the downgraded rate is always one that passed the check, but under rate monotonic it isn't necessarily
+     * the highest one that would, see the comment on the search
+     */
+    AdmissionResult try_admit(std::string name, int rate_hz, double wcet_seconds, int minimum_rate_hz = 0) {
+        Task task{next_task_id, std::move(name), rate_hz, wcet_seconds, 0};
+
+        if (is_schedulable_with(task)) {
+            return admit(std::move(task), Outcome::admitted);
+        }
+
+        if (minimum_rate_hz > 0 && minimum_rate_hz < rate_hz) {
+            task.rate_hz = minimum_rate_hz;
+            if (is_schedulable_with(task)) {
+                // binary search for the highest rate that fits, every rate we settle on has passed the check itself.
+                // Under edf this finds the highest one since utilization only drops with the rate, but under rate
+                // monotonic lowering the rate can move the task below others in priority, and the response time
+                // analysis isn't monotonic in the rate, so a higher rate than the one found may also fit
+                int schedulable_rate_hz = minimum_rate_hz;
+                int unschedulable_rate_hz = rate_hz;
+                while (unschedulable_rate_hz - schedulable_rate_hz > 1) {
+                    task.rate_hz = schedulable_rate_hz + (unschedulable_rate_hz - schedulable_rate_hz) / 2;
+                    if (is_schedulable_with(task)) {
+                        schedulable_rate_hz = task.rate_hz;
+                    } else {
+                        unschedulable_rate_hz = task.rate_hz;
+                    }
+                }
+                task.rate_hz = schedulable_rate_hz;
+                return admit(std::move(task), Outcome::downgraded);
+            }
+        }
+
+        return {Outcome::rejected, 0, 0, get_total_utilization()};
+    }
+
+    /**
+     * @brief removes a task, returns false if there is no such task
+     */
+    bool remove_task(TaskId task_id) {
+        auto task = find_task(task_id);
+        if (task == tasks.end()) {
+            return false;
+        }
+        tasks.erase(task);
+        return true;
+    }
+
+    /**
+     * @brief reports how long one execution of the task took, the task's wcet grows if this is the longest one yet
+     */
+    void record_execution_time(TaskId task_id, double seconds) {
+        auto task = find_task(task_id);
+        if (task != tasks.end()) {
+            task->measured_wcet_seconds = std::max(task->measured_wcet_seconds, seconds);
+        }
+    }
+
+    /**
+     * @brief rechecks the current task set, this can turn false after measured execution times grow
+     */
+    bool is_schedulable() const { return is_schedulable(tasks); }
+
+    double get_total_utilization() const { return get_total_utilization(tasks); }
+
+    const std::vector<Task> &get_tasks() const { return tasks; }
+
+  private:
+    SchedulingPolicy scheduling_policy;
+    double utilization_limit;
+    std::vector<Task> tasks;
+    TaskId next_task_id = 0;
+
+    std::vector<Task>::iterator find_task(TaskId task_id) {
+        return std::find_if(tasks.begin(), tasks.end(), [task_id](const Task &task) { return task.id == task_id; });
+    }
+
+    AdmissionResult admit(Task task, Outcome outcome) {
+        next_task_id++;
+        AdmissionResult result{outcome, task.id, task.rate_hz, 0};
+        tasks.push_back(std::move(task));
+        result.utilization = get_total_utilization();
+        return result;
+    }
+
+    bool is_schedulable_with(const Task &task) const {
+        std::vector<Task> candidate_tasks = tasks;
+        candidate_tasks.push_back(task);
+        return is_schedulable(candidate_tasks);
+    }
+
+    static double get_total_utilization(const std::vector<Task> &task_set) {
+        double utilization = 0;
+        for (const Task &task : task_set) {
+            utilization += task.get_utilization();
+        }
+        return utilization;
+    }
+
+    bool is_schedulable(const std::vector<Task> &task_set) const {
+        double utilization = get_total_utilization(task_set);
+        if (utilization > utilization_limit) {
+            return false;
+        }
+        if (scheduling_policy == SchedulingPolicy::earliest_deadline_first) {
+            return true;
+        }
+
+        // hyperbolic bound, scaled so that a limit below 1 shrinks the usable time of every task
+        double product = 1;
+        for (const Task &task : task_set) {
+            product *= task.get_utilization() / utilization_limit + 1;
+        }
+        if (product <= 2) {
+            return true;
+        }
+        return passes_response_time_analysis(task_set);
+    }
+
+    /**
+     * @brief for every task, the longest time from its release to its completion has to fit within its period, where
+     * the response time is its own wcet plus every higher priority task that gets released in the meantime
+     */
+    bool passes_response_time_analysis(std::vector<Task> task_set) const {
+        // stable so that tasks with the same rate keep the order they were admitted in, and the same task set always
+        // gets the same answer
+        std::stable_sort(task_set.begin(), task_set.end(),
+                         [](const Task &a, const Task &b) { return a.rate_hz > b.rate_hz; });
+        for (std::size_t i = 0; i < task_set.size(); i++) {
+            double deadline = task_set[i].get_period_seconds() * utilization_limit;
+            double response_time = task_set[i].get_wcet_seconds();
+            while (true) {
+                double next_response_time = task_set[i].get_wcet_seconds();
+                for (std::size_t j = 0; j < i; j++) {
+                    next_response_time +=
+                        std::ceil(response_time / task_set[j].get_period_seconds()) * task_set[j].get_wcet_seconds();
+                }
+                if (next_response_time > deadline) {
+                    return false;
+                }
+                // the iteration only ever grows, so once it stops changing we've found the response time
+                if (next_response_time <= response_time) {
+                    break;
+                }
+                response_time = next_response_time;
+            }
+        }
+        return true;
+    }
+};
+
+#endif // ADMISSION_CONTROLLER_HPP
@@ -0,0 +1,373 @@
+#ifndef CONCURRENT_TIMER_SCHEDULER_HPP
+#define CONCURRENT_TIMER_SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "timer_scheduler.hpp"
+
+/**
+ * @brief the state a ConcurrentTimerScheduler timer is in, shared between the poll thread and whoever holds a handle
+ */
+enum class ConcurrentTimerState {
+    // the handle doesn't refer to a timer, eg it was default constructed
+    none,
+    // waiting to be picked up by the poll thread, or waiting for its deadline
+    scheduled,
+    // the callback is running on the poll thread right now
+    firing,
+    cancelled,
+    // a one-shot timer which has fired
+    finished,
+};
+
+class ConcurrentTimerScheduler;
+
+/**
+ * @brief refers to a timer in a ConcurrentTimerScheduler, it can be copied to and used from any thread
+ */
+class ConcurrentTimerHandle {
+  public:
+    ConcurrentTimerHandle() = default;
+
+    bool is_valid() const { return control != nullptr; }
+
+    ConcurrentTimerState get_state() const {
+        if (!is_valid()) {
+            return ConcurrentTimerState::none;
+        }
+        return control->state.load(std::memory_order_acquire);
+    }
+
+  private:
+    friend class ConcurrentTimerScheduler;
+
+    struct Control {
+        std::atomic<ConcurrentTimerState> state{ConcurrentTimerState::scheduled};
+        bool periodic = false;
+        // only touched by the poll thread
+        TimerHandle timer_handle;
+    };
+
+    explicit ConcurrentTimerHandle(std::shared_ptr<Control> control) : control(std::move(control)) {}
+
+    std::shared_ptr<Control> control;
+};
+
+/**
+ * @brief a TimerScheduler which timers can be scheduled on and cancelled from any thread
+ *
+ * @details the TimerScheduler underneath is owned by the poll thread, other threads never touch it. Scheduling and
+ * cancelling instead push a command onto a lock free multi producer single consumer queue (a linked list where a push
+ * is a single atomic exchange) and @see poll applies every queued command before it fires any timers.
+ *
+ * command nodes come from a pool that is allocated up front. The poll thread hands each node back through a lock free
+ * free list once it has applied it, and the scheduling threads take nodes from that list. So while the pool lasts,
+ * neither side touches the allocator for commands. When the pool runs out, nodes are allocated and deleted as
+ * usual. What still allocates is what belongs to the timer itself: the control block shared with the handles, and
+ * the callback if it doesn't fit in std::function's small buffer. They are freed by whoever drops the last
+ * reference, which is the poll thread if the timer finishes or is cancelled after every handle to it is gone. Keep
+ * a handle, or keep the callback's captures small, if that free must not happen on the poll thread.
+ *
+ * every timer has a small control block with an atomic state, cancelling a timer is one compare and swap on that
+ * state, so it's O(1) and takes effect right away even though the command to remove the timer from the heap is only
+ * applied at the next poll. The poll thread moves a timer from scheduled to firing with a compare and swap before
+ * running its callback, so the two can't race: either the cancel wins and the callback never runs, or the callback
+ * was already running, in which case a periodic timer won't fire again and cancelling a one-shot timer fails.
+ *
+ * usage:
+ *
+ *     ConcurrentTimerScheduler scheduler;
+ *     // any thread
+ *     auto handle = scheduler.schedule_after(std::chrono::seconds(5), [](const ConcurrentTimerHandle &) { ... });
+ *     scheduler.cancel(handle);
+ *     // the poll thread
+ *     while (running) {
+ *         scheduler.poll();
+ *     }
+ */
+class ConcurrentTimerScheduler {
+  public:
+    using Clock = TimerScheduler::Clock;
+    using Callback = std::function<void(const ConcurrentTimerHandle &)>;
+
+    /**
+     * @param command_pool_size how many commands can be queued at once before scheduling and cancelling fall back to
+     * allocating
+     */
+    explicit ConcurrentTimerScheduler(std::size_t command_pool_size = 1024)
+        : command_pool(new Command[command_pool_size]), command_pool_size(command_pool_size) {
+        for (std::size_t i = 0; i < command_pool_size; i++) {
+            release_command(&command_pool[i]);
+        }
+        // the queue always holds at least one node, the consumer owns the oldest one
+        command_queue_tail = acquire_command();
+        command_queue_head.store(command_queue_tail, std::memory_order_relaxed);
+    }
+
+    ConcurrentTimerScheduler(const ConcurrentTimerScheduler &) = delete;
+    ConcurrentTimerScheduler &operator=(const ConcurrentTimerScheduler &) = delete;
+
+    /**
+     * @note no other thread may be scheduling or cancelling by the time this runs
+     */
+    ~ConcurrentTimerScheduler() {
+        while (Command *command = pop_command()) {
+            release_command(command);
+        }
+        release_command(command_queue_tail);
+    }
+
+    /**
+     * @brief schedules a callback to run once at the given deadline, safe to call from any thread
+     */
+    ConcurrentTimerHandle schedule_at(Clock::time_point deadline, Callback callback) {
+        return push_schedule_command(deadline, Clock::duration::zero(), std::move(callback));
+    }
+
+    /**
+     * @brief schedules a callback to run once after the given delay, safe to call from any thread
+     */
+    ConcurrentTimerHandle schedule_after(Clock::duration delay, Callback callback) {
+        return schedule_at(Clock::now() + delay, std::move(callback));
+    }
+
+    /**
+     * @brief schedules a callback to run at a fixed rate, safe to call from any thread
+     *
+     * @details the timeline starts when this is called, not when the poll thread picks the timer up, so the first
+     * call happens one period from now
+     *
+     * @return an invalid handle if the period isn't positive
+     */
+    ConcurrentTimerHandle schedule_periodic(Clock::duration period, Callback callback) {
+        if (period <= Clock::duration::zero()) {
+            return {};
+        }
+        return push_schedule_command(Clock::now(), period, std::move(callback));
+    }
+
+    /**
+     * @return an invalid handle if the rate isn't positive
+     */
+    ConcurrentTimerHandle schedule_periodic(int rate_hz, Callback callback) {
+        if (rate_hz <= 0) {
+            return {};
+        }
+        auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate_hz));
+        return schedule_periodic(period, std::move(callback));
+    }
+
+    /**
+     * @brief cancels the timer, safe to call from any thread, including from inside of a callback
+     *
+     * @return true if the timer won't start firing again, false if it had already been cancelled or was a one-shot
+     * timer which has already fired or is firing right now
+     */
+    bool cancel(const ConcurrentTimerHandle &handle) {
+        if (!handle.is_valid()) {
+            return false;
+        }
+        ConcurrentTimerState state = handle.control->state.load(std::memory_order_acquire);
+        while (true) {
+            // a periodic timer that's firing can still be stopped from firing again
+            bool periodic_firing = state == ConcurrentTimerState::firing && handle.control->periodic;
+            if (state != ConcurrentTimerState::scheduled && !periodic_firing) {
+                return false;
+            }
+            if (handle.control->state.compare_exchange_weak(state, ConcurrentTimerState::cancelled,
+                                                            std::memory_order_acq_rel)) {
+                break;
+            }
+        }
+
+        // the timer is already dead, this just gets it out of the heap before its deadline comes around
+        Command *command = acquire_command();
+        command->type = CommandType::cancel;
+        command->control = handle.control;
+        push_command(command);
+        return true;
+    }
+
+    /**
+     * @brief applies every queued command and then fires every timer that is due, returns how many callbacks were run
+     *
+     * @note only one thread may poll
+     */
+    std::size_t poll(Clock::time_point now = Clock::now()) {
+        apply_commands();
+        return timer_scheduler.poll(now);
+    }
+
+    /**
+     * @brief the earliest deadline of the timers the poll thread knows about
+     *
+     * @note only call this from the poll thread, timers scheduled since the last poll aren't included
+     */
+    std::optional<Clock::time_point> get_next_deadline() { return timer_scheduler.get_next_deadline(); }
+
+    /**
+     * @brief the number of timers the poll thread knows about
+     *
+     * @note only call this from the poll thread
+     */
+    std::size_t size() const { return timer_scheduler.size(); }
+
+  private:
+    enum class CommandType {
+        schedule,
+        cancel,
+    };
+
+    struct Command {
+        std::atomic<Command *> next{nullptr};
+        // the next pool index on the free list while the node is free
+        std::atomic<std::uint32_t> next_free_index{no_command_index};
+        CommandType type = CommandType::schedule;
+        std::shared_ptr<ConcurrentTimerHandle::Control> control;
+        Clock::time_point deadline;
+        // zero for one-shot timers, for periodic timers deadline is the anchor
+        Clock::duration period = Clock::duration::zero();
+        Callback callback;
+    };
+
+    static constexpr std::uint32_t no_command_index = UINT32_MAX;
+
+    TimerScheduler timer_scheduler;
+
+    std::unique_ptr<Command[]> command_pool;
+    std::size_t command_pool_size;
+    // the index of the first free pool node in the low half and a counter which is bumped on every change in the high
+    // half, so a node that is taken and handed back between a load and a compare and swap can't fool a taker (aba)
+    alignas(64) std::atomic<std::uint64_t> free_command_list{no_command_index};
+
+    alignas(64) std::atomic<Command *> command_queue_head;
+    alignas(64) Command *command_queue_tail;
+
+    ConcurrentTimerHandle push_schedule_command(Clock::time_point deadline, Clock::duration period, Callback callback) {
+        auto control = std::make_shared<ConcurrentTimerHandle::Control>();
+        control->periodic = period != Clock::duration::zero();
+        Command *command = acquire_command();
+        command->type = CommandType::schedule;
+        command->control = control;
+        command->deadline = deadline;
+        command->period = period;
+        command->callback = std::move(callback);
+        push_command(command);
+        return ConcurrentTimerHandle(std::move(control));
+    }
+
+    /**
+     * @brief takes a node off the free list, or allocates one if the pool is used up, safe to call from any thread
+     */
+    Command *acquire_command() {
+        std::uint64_t free_list = free_command_list.load(std::memory_order_acquire);
+        while (true) {
+            auto index = static_cast<std::uint32_t>(free_list);
+            if (index == no_command_index) {
+                return new Command();
+            }
+            std::uint32_t next_index = command_pool[index].next_free_index.load(std::memory_order_relaxed);
+            std::uint64_t next_free_list = ((free_list >> 32) + 1) << 32 | next_index;
+            if (free_command_list.compare_exchange_weak(free_list, next_free_list, std::memory_order_acquire)) {
+                Command *command = &command_pool[index];
+                command->next.store(nullptr, std::memory_order_relaxed);
+                return command;
+            }
+        }
+    }
+
+    /**
+     * @brief hands a node back to the pool, or deletes it if it was allocated because the pool was used up
+     */
+    void release_command(Command *command) {
+        command->control = nullptr;
+        command->callback = nullptr;
+        std::less<const Command *> before;
+        if (before(command, command_pool.get()) || !before(command, command_pool.get() + command_pool_size)) {
+            delete command;
+            return;
+        }
+        auto index = static_cast<std::uint32_t>(command - command_pool.get());
+        std::uint64_t free_list = free_command_list.load(std::memory_order_relaxed);
+        while (true) {
+            command->next_free_index.store(static_cast<std::uint32_t>(free_list), std::memory_order_relaxed);
+            std::uint64_t next_free_list = ((free_list >> 32) + 1) << 32 | index;
+            if (free_command_list.compare_exchange_weak(free_list, next_free_list, std::memory_order_release,
+                                                        std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    void push_command(Command *command) {
+        Command *previous_head = command_queue_head.exchange(command, std::memory_order_acq_rel);
+        previous_head->next.store(command, std::memory_order_release);
+    }
+
+    /**
+     * @brief the oldest command, or nullptr if there is none (or the newest push hasn't been linked in yet)
+     */
+    Command *pop_command() {
+        Command *next = command_queue_tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return nullptr;
+        }
+        // next becomes the new stub, so hand its contents out in the old stub
+        Command *command = command_queue_tail;
+        command->type = next->type;
+        command->control = std::move(next->control);
+        command->deadline = next->deadline;
+        command->period = next->period;
+        command->callback = std::move(next->callback);
+        command_queue_tail = next;
+        return command;
+    }
+
+    void apply_commands() {
+        while (Command *command = pop_command()) {
+            if (command->type == CommandType::schedule) {
+                apply_schedule_command(*command);
+            } else {
+                timer_scheduler.cancel(command->control->timer_handle);
+            }
+            release_command(command);
+        }
+    }
+
+    void apply_schedule_command(Command &command) {
+        std::shared_ptr<ConcurrentTimerHandle::Control> control = command.control;
+        if (control->state.load(std::memory_order_acquire) == ConcurrentTimerState::cancelled) {
+            return;
+        }
+
+        bool periodic = control->periodic;
+        auto fire = [control, periodic, callback = std::move(command.callback)](TimerHandle) {
+            ConcurrentTimerState expected = ConcurrentTimerState::scheduled;
+            if (!control->state.compare_exchange_strong(expected, ConcurrentTimerState::firing,
+                                                        std::memory_order_acq_rel)) {
+                // cancelled, the cancel command will take the timer out of the heap
+                return;
+            }
+            callback(ConcurrentTimerHandle(control));
+            expected = ConcurrentTimerState::firing;
+            control->state.compare_exchange_strong(expected, periodic ? ConcurrentTimerState::scheduled
+                                                                      : ConcurrentTimerState::finished,
+                                                   std::memory_order_acq_rel);
+        };
+
+        if (periodic) {
+            control->timer_handle =
+                timer_scheduler.schedule_periodic(command.period, std::move(fire), command.deadline);
+        } else {
+            control->timer_handle = timer_scheduler.schedule_at(command.deadline, std::move(fire));
+        }
+    }
+};
+
+#endif // CONCURRENT_TIMER_SCHEDULER_HPP
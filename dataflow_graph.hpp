@@ -0,0 +1,392 @@
+#ifndef DATAFLOW_GRAPH_HPP
+#define DATAFLOW_GRAPH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief what happens to the values on an edge between two nodes which run at different rates
+ *
+ * latest_value: the consumer only ever sees the newest value, anything it didn't get to is overwritten, eg input state
+ * going from a 1kHz poller to a 128Hz simulation
+ *
+ * accumulate: every value the producer pushed since the consumer last looked is folded into one value with a combine
+ * function, eg mouse deltas, or counters going to telemetry
+ *
+ * decimate: only every n'th value the producer pushes is kept and the consumer sees all of the kept ones, eg
+ * downsampling a signal
+ *
+ * queue_all: the consumer sees every value in order, eg events or network messages
+ */
+enum class RateConversion {
+    latest_value,
+    accumulate,
+    decimate,
+    queue_all,
+};
+
+/**
+ * @brief the base of every edge so that the graph can own edges of different types
+ */
+class DataflowEdgeBase {
+  public:
+    virtual ~DataflowEdgeBase() = default;
+};
+
+/**
+ * @brief a lock free single producer single consumer buffer carrying values of type T from one node to another
+ *
+ * @details latest_value edges are a triple buffer, the producer and consumer each own one slot and swap with the
+ * middle one through a single atomic, so neither ever waits on the other and there's no queue to fill up. The other
+ * conversions are a fixed capacity ring buffer, if the consumer falls so far behind that the ring is full new values
+ * are dropped and counted.
+ *
+ * @note exactly one node may push and exactly one node may consume, nothing is allocated after construction
+ */
+template <typename T> class RateConversionBuffer : public DataflowEdgeBase {
+  public:
+    using Combine = std::function<void(T &accumulated, const T &value)>;
+
+    /**
+     * @param capacity the ring capacity, rounded up to a power of two, unused for latest_value
+     * @param decimation_factor for decimate, keep one out of this many values
+     * @param combine for accumulate, folds a value into the accumulated value, required for accumulate
+     *
+     * @throws std::invalid_argument if the conversion is accumulate and there is no combine
+     */
+    RateConversionBuffer(RateConversion conversion, std::size_t capacity = 64, std::size_t decimation_factor = 1,
+                         Combine combine = nullptr)
+        : conversion(conversion), decimation_factor(std::max<std::size_t>(1, decimation_factor)),
+          combine(std::move(combine)) {
+        if (conversion == RateConversion::accumulate && !this->combine) {
+            throw std::invalid_argument("an accumulate edge needs a combine function");
+        }
+        std::size_t ring_capacity = 1;
+        while (ring_capacity < capacity) {
+            ring_capacity *= 2;
+        }
+        if (conversion != RateConversion::latest_value) {
+            ring.resize(ring_capacity);
+        }
+        ring_mask = ring_capacity - 1;
+    }
+
+    /**
+     * @brief called by the producing node, returns false if the value was dropped because the ring was full
+     */
+    bool push(const T &value) {
+        if (conversion == RateConversion::latest_value) {
+            triple_buffer[producer_slot] = value;
+            producer_slot = middle_slot.exchange(producer_slot | fresh_bit, std::memory_order_acq_rel) & slot_mask;
+            return true;
+        }
+
+        if (conversion == RateConversion::decimate && push_count++ % decimation_factor != 0) {
+            return true;
+        }
+
+        std::size_t tail = ring_tail.load(std::memory_order_relaxed);
+        if (tail - ring_head.load(std::memory_order_acquire) == ring.size()) {
+            dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ring[tail & ring_mask] = value;
+        ring_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief called by the consuming node, hands on_value whatever the conversion says the consumer should see
+     *
+     * @return how many times on_value was called
+     */
+    template <typename OnValue> std::size_t consume(OnValue &&on_value) {
+        if (conversion == RateConversion::latest_value) {
+            if ((middle_slot.load(std::memory_order_relaxed) & fresh_bit) == 0) {
+                return 0;
+            }
+            consumer_slot = middle_slot.exchange(consumer_slot, std::memory_order_acq_rel) & slot_mask;
+            on_value(static_cast<const T &>(triple_buffer[consumer_slot]));
+            return 1;
+        }
+
+        std::size_t head = ring_head.load(std::memory_order_relaxed);
+        std::size_t tail = ring_tail.load(std::memory_order_acquire);
+        if (head == tail) {
+            return 0;
+        }
+
+        if (conversion == RateConversion::accumulate) {
+            T accumulated = ring[head & ring_mask];
+            for (std::size_t i = head + 1; i != tail; i++) {
+                combine(accumulated, ring[i & ring_mask]);
+            }
+            ring_head.store(tail, std::memory_order_release);
+            on_value(static_cast<const T &>(accumulated));
+            return 1;
+        }
+
+        std::size_t value_count = 0;
+        for (; head != tail; head++) {
+            on_value(static_cast<const T &>(ring[head & ring_mask]));
+            value_count++;
+        }
+        ring_head.store(tail, std::memory_order_release);
+        return value_count;
+    }
+
+    /**
+     * @brief the number of values dropped because the consumer fell behind and the ring was full
+     */
+    std::uint64_t get_dropped_count() const { return dropped_count.load(std::memory_order_relaxed); }
+
+    RateConversion get_conversion() const { return conversion; }
+
+  private:
+    static constexpr std::uint8_t slot_mask = 0x3;
+    static constexpr std::uint8_t fresh_bit = 0x4;
+
+    RateConversion conversion;
+    std::size_t decimation_factor;
+    Combine combine;
+
+    // latest value
+    T triple_buffer[3] = {};
+    std::uint8_t producer_slot = 0;
+    alignas(64) std::atomic<std::uint8_t> middle_slot{1};
+    alignas(64) std::uint8_t consumer_slot = 2;
+
+    // everything else
+    std::vector<T> ring;
+    std::size_t ring_mask;
+    std::size_t push_count = 0;
+    alignas(64) std::atomic<std::size_t> ring_tail{0};
+    alignas(64) std::atomic<std::size_t> ring_head{0};
+    std::atomic<std::uint64_t> dropped_count{0};
+};
+
+/**
+ * @brief runs a graph of nodes, each at its own rate, on a fixed number of threads
+ *
+ * @details every node is driven by its own PeriodicSignal and does its work whenever its signal fires. Nodes talk to
+ * each other only through RateConversionBuffer edges, so there are no locks anywhere between nodes even when they end
+ * up on different threads.
+ *
+ * nodes are assigned to threads by descending rate, each going to the thread with the least utilization so far
+ * (rate * declared cost), unless pinned with @see set_node_thread. On each thread the nodes are ordered so that
+ * producers run before their consumers when both are due at the same time, and between ticks the thread sleeps
+ * until the earliest next signal of its nodes.
+ *
+ * usage:
+ *
+ *     DataflowGraph graph;
+ *     auto input = graph.add_node("input", 1000);
+ *     auto simulation = graph.add_node("simulation", 128);
+ *     auto &input_edge = graph.add_edge<InputState>(input, simulation, RateConversion::latest_value);
+ *     graph.set_node_work(input, [&] { input_edge.push(poll_input()); });
+ *     graph.set_node_work(simulation, [&] { input_edge.consume([&](const InputState &state) { step(state); }); });
+ *     graph.start(2);
+ *
+ * @note the graph can't be changed while it's running
+ */
+class DataflowGraph {
+  public:
+    using NodeId = std::size_t;
+
+    DataflowGraph() = default;
+    DataflowGraph(const DataflowGraph &) = delete;
+    DataflowGraph &operator=(const DataflowGraph &) = delete;
+
+    ~DataflowGraph() { stop(); }
+
+    /**
+     * @param cost_seconds roughly how long one tick of the node's work takes, only used to balance threads
+     */
+    NodeId add_node(std::string name, int rate_hz, std::function<void()> work = nullptr, double cost_seconds = 0) {
+        nodes.push_back({std::move(name), rate_hz, std::move(work), cost_seconds, -1});
+        return nodes.size() - 1;
+    }
+
+    void set_node_work(NodeId node_id, std::function<void()> work) { nodes[node_id].work = std::move(work); }
+
+    /**
+     * @brief pins the node to one of the threads that @see start creates
+     */
+    void set_node_thread(NodeId node_id, int thread_index) { nodes[node_id].pinned_thread = thread_index; }
+
+    /**
+     * @brief creates an edge from one node to another, the returned buffer lives as long as the graph
+     *
+     * @throws std::invalid_argument if the conversion is accumulate and there is no combine
+     */
+    template <typename T>
+    RateConversionBuffer<T> &add_edge(NodeId from, NodeId to, RateConversion conversion, std::size_t capacity = 64,
+                                      std::size_t decimation_factor = 1,
+                                      typename RateConversionBuffer<T>::Combine combine = nullptr) {
+        auto edge =
+            std::make_unique<RateConversionBuffer<T>>(conversion, capacity, decimation_factor, std::move(combine));
+        RateConversionBuffer<T> &edge_reference = *edge;
+        edges.push_back(std::move(edge));
+        connections.push_back({from, to});
+        return edge_reference;
+    }
+
+    /**
+     * @brief assigns the nodes to threads and starts running them, returns false if the graph is already running
+     */
+    bool start(std::size_t thread_count) {
+        if (running) {
+            return false;
+        }
+        thread_count = std::max<std::size_t>(1, thread_count);
+        std::vector<std::vector<NodeId>> thread_nodes = assign_nodes_to_threads(thread_count);
+
+        running = true;
+        for (std::vector<NodeId> &node_ids : thread_nodes) {
+            if (node_ids.empty()) {
+                continue;
+            }
+            threads.emplace_back([this, node_ids] { run_nodes(node_ids); });
+        }
+        return true;
+    }
+
+    void stop() {
+        running = false;
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
+
+    /**
+     * @brief the nodes in an order where every producer comes before its consumers, cycles are left in insertion order
+     */
+    std::vector<NodeId> get_topological_order() const {
+        std::vector<std::size_t> incoming_count(nodes.size(), 0);
+        for (const Connection &connection : connections) {
+            if (connection.from != connection.to) {
+                incoming_count[connection.to]++;
+            }
+        }
+
+        std::vector<NodeId> order;
+        std::vector<bool> placed(nodes.size(), false);
+        while (order.size() < nodes.size()) {
+            bool placed_any = false;
+            for (NodeId node_id = 0; node_id < nodes.size(); node_id++) {
+                if (placed[node_id] || incoming_count[node_id] != 0) {
+                    continue;
+                }
+                place_node(node_id, order, placed, incoming_count);
+                placed_any = true;
+            }
+            if (!placed_any) {
+                // there's a cycle, break it at the first node that isn't placed yet
+                NodeId node_id = std::find(placed.begin(), placed.end(), false) - placed.begin();
+                place_node(node_id, order, placed, incoming_count);
+            }
+        }
+        return order;
+    }
+
+  private:
+    struct Node {
+        std::string name;
+        int rate_hz;
+        std::function<void()> work;
+        double cost_seconds;
+        int pinned_thread;
+    };
+
+    struct Connection {
+        NodeId from;
+        NodeId to;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<std::unique_ptr<DataflowEdgeBase>> edges;
+    std::vector<Connection> connections;
+    std::atomic<bool> running{false};
+    std::vector<std::thread> threads;
+
+    void place_node(NodeId node_id, std::vector<NodeId> &order, std::vector<bool> &placed,
+                    std::vector<std::size_t> &incoming_count) const {
+        placed[node_id] = true;
+        order.push_back(node_id);
+        for (const Connection &connection : connections) {
+            if (connection.from == node_id && connection.to != node_id && incoming_count[connection.to] > 0) {
+                incoming_count[connection.to]--;
+            }
+        }
+    }
+
+    std::vector<std::vector<NodeId>> assign_nodes_to_threads(std::size_t thread_count) const {
+        std::vector<std::vector<NodeId>> thread_nodes(thread_count);
+        std::vector<double> thread_utilizations(thread_count, 0);
+
+        std::vector<NodeId> by_rate(nodes.size());
+        for (NodeId node_id = 0; node_id < nodes.size(); node_id++) {
+            by_rate[node_id] = node_id;
+        }
+        std::stable_sort(by_rate.begin(), by_rate.end(),
+                         [this](NodeId a, NodeId b) { return nodes[a].rate_hz > nodes[b].rate_hz; });
+
+        std::vector<int> node_threads(nodes.size(), 0);
+        for (NodeId node_id : by_rate) {
+            const Node &node = nodes[node_id];
+            std::size_t thread_index = 0;
+            if (node.pinned_thread >= 0) {
+                thread_index = static_cast<std::size_t>(node.pinned_thread) % thread_count;
+            } else {
+                // with no declared costs this still spreads the nodes out, since each counts as a bit of utilization
+                thread_index = std::min_element(thread_utilizations.begin(), thread_utilizations.end()) -
+                               thread_utilizations.begin();
+            }
+            thread_utilizations[thread_index] += node.rate_hz * std::max(node.cost_seconds, 1e-9);
+            node_threads[node_id] = static_cast<int>(thread_index);
+        }
+
+        for (NodeId node_id : get_topological_order()) {
+            thread_nodes[node_threads[node_id]].push_back(node_id);
+        }
+        return thread_nodes;
+    }
+
+    void run_nodes(const std::vector<NodeId> &node_ids) {
+        std::vector<PeriodicSignal> signals;
+        signals.reserve(node_ids.size());
+        for (NodeId node_id : node_ids) {
+            signals.emplace_back(nodes[node_id].rate_hz, DeltaMode::perfect);
+        }
+
+        while (running) {
+            for (std::size_t i = 0; i < node_ids.size(); i++) {
+                if (signals[i].process_and_get_signal() && nodes[node_ids[i]].work) {
+                    nodes[node_ids[i]].work();
+                }
+            }
+
+            auto next_signal_time = std::chrono::steady_clock::time_point::max();
+            for (const PeriodicSignal &signal : signals) {
+                next_signal_time = std::min(next_signal_time, signal.get_next_signal_time());
+            }
+            // don't sleep past a stop request for too long
+            auto latest_wake_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            std::this_thread::sleep_until(std::min(next_signal_time, latest_wake_time));
+        }
+    }
+};
+
+#endif // DATAFLOW_GRAPH_HPP
@@ -0,0 +1,258 @@
+#ifndef DATAGRAM_QUEUE_HPP
+#define DATAGRAM_QUEUE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief a fixed capacity queue of outgoing udp datagrams which can be sent with as few syscalls as possible
+ *
+ * @details all storage is allocated up front, every datagram gets a slot of max_datagram_size bytes in one contiguous
+ * buffer, so enqueueing never allocates. On linux datagrams are sent with sendmmsg, and when UDP GSO is available runs
+ * of consecutive datagrams going to the same address with the same size are handed to the kernel as a single message
+ * which it segments for us. If the kernel or the nic refuses GSO we turn it off and fall back to one message per
+ * datagram. On other platforms we fall back to one sendto per datagram.
+ *
+ * GSO starts out off, UDP_SEGMENT being defined only says the headers know about it. A kernel older than 4.18 ignores
+ * the control message and would send the whole run as one oversized datagram, so call @see enable_gso_if_supported
+ * with the socket to turn it on only when the running kernel accepts the option on that socket.
+ */
+class DatagramQueue {
+  public:
+    DatagramQueue(std::size_t max_datagram_count, std::size_t max_datagram_size = 1472)
+        : max_datagram_count(max_datagram_count), max_datagram_size(max_datagram_size),
+          payloads(max_datagram_count * max_datagram_size), datagrams(max_datagram_count) {
+#ifdef __linux__
+        iovecs.resize(max_datagram_count);
+        messages.resize(max_datagram_count);
+        message_first_datagram.resize(max_datagram_count);
+        control_buffers.resize(max_datagram_count);
+#endif
+    }
+
+    DatagramQueue(const DatagramQueue &) = delete;
+    DatagramQueue &operator=(const DatagramQueue &) = delete;
+
+    /**
+     * @brief copies the datagram into the queue, returns false if the queue is full or the datagram is too large
+     */
+    bool push(const void *data, std::size_t size, const sockaddr *address, socklen_t address_length) {
+        if (datagram_count == max_datagram_count || size > max_datagram_size ||
+            address_length > static_cast<socklen_t>(sizeof(sockaddr_storage))) {
+            return false;
+        }
+        Datagram &datagram = datagrams[datagram_count];
+        std::memcpy(get_payload(datagram_count), data, size);
+        std::memcpy(&datagram.address, address, address_length);
+        datagram.address_length = address_length;
+        datagram.size = size;
+        datagram_count++;
+        return true;
+    }
+
+    std::size_t size() const { return datagram_count; }
+    bool empty() const { return datagram_count == 0; }
+    bool full() const { return datagram_count == max_datagram_count; }
+    std::size_t capacity() const { return max_datagram_count; }
+
+    void clear() { datagram_count = 0; }
+
+    /**
+     * @note only force this on for a socket that you know supports GSO, otherwise use @see enable_gso_if_supported
+     */
+    void set_gso_enabled(bool enabled) { gso_enabled = enabled; }
+    bool is_gso_enabled() const { return gso_enabled; }
+
+    /**
+     * @brief turns GSO on if the kernel supports it on this socket and off otherwise, returns whether it's on
+     */
+    bool enable_gso_if_supported(int socket_fd) {
+        gso_enabled = is_gso_supported(socket_fd);
+        return gso_enabled;
+    }
+
+    /**
+     * @brief asks the kernel whether the socket accepts UDP_SEGMENT, kernels which don't know it reject the option
+     */
+    static bool is_gso_supported(int socket_fd) {
+#if defined(__linux__) && defined(UDP_SEGMENT)
+        int segment_size = 0;
+        socklen_t option_length = sizeof(segment_size);
+        return getsockopt(socket_fd, SOL_UDP, UDP_SEGMENT, &segment_size, &option_length) == 0;
+#else
+        (void)socket_fd;
+        return false;
+#endif
+    }
+
+    /**
+     * @brief the result of sending a range of the queue
+     */
+    struct SendResult {
+        std::size_t datagrams_sent = 0;
+        std::size_t datagrams_failed = 0;
+        std::size_t syscall_count = 0;
+    };
+
+    /**
+     * @brief sends the datagrams in [first, first + count) to the socket
+     *
+     * @note the datagrams stay in the queue, call @see clear once everything you want to send has been sent
+     */
+    SendResult send(int socket_fd, std::size_t first, std::size_t count) {
+        SendResult result;
+        count = std::min(count, datagram_count - std::min(first, datagram_count));
+        std::size_t end = first + count;
+
+#ifdef __linux__
+        std::size_t next_datagram = first;
+        while (next_datagram < end) {
+            std::size_t message_count = build_messages(next_datagram, end);
+            std::size_t next_message = 0;
+            while (next_message < message_count) {
+                int sent_count = sendmmsg(socket_fd, &messages[next_message],
+                                          static_cast<unsigned int>(message_count - next_message), 0);
+                result.syscall_count++;
+                if (sent_count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (gso_enabled && messages[next_message].msg_hdr.msg_controllen != 0 &&
+                        (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+                        // gso isn't supported for this socket or device, rebuild the rest without it
+                        gso_enabled = false;
+                        break;
+                    }
+                    // the datagram that failed is dropped, udp gives no delivery guarantee anyways
+                    std::size_t failed_end = get_message_end(next_message, message_count, end);
+                    result.datagrams_failed += failed_end - message_first_datagram[next_message];
+                    next_message++;
+                    continue;
+                }
+                std::size_t sent_end = get_message_end(next_message + sent_count - 1, message_count, end);
+                result.datagrams_sent += sent_end - message_first_datagram[next_message];
+                next_message += static_cast<std::size_t>(sent_count);
+            }
+            // if we stopped early it's because gso was turned off, so pick up where we left off
+            next_datagram = next_message < message_count ? message_first_datagram[next_message] : end;
+        }
+#else
+        for (std::size_t i = first; i < end; i++) {
+            const Datagram &datagram = datagrams[i];
+            auto sent = sendto(socket_fd, reinterpret_cast<const char *>(get_payload(i)), datagram.size, 0,
+                               reinterpret_cast<const sockaddr *>(&datagram.address), datagram.address_length);
+            result.syscall_count++;
+            if (sent < 0) {
+                result.datagrams_failed++;
+            } else {
+                result.datagrams_sent++;
+            }
+        }
+#endif
+        return result;
+    }
+
+  private:
+    struct Datagram {
+        sockaddr_storage address;
+        socklen_t address_length;
+        std::size_t size;
+    };
+
+    std::size_t max_datagram_count;
+    std::size_t max_datagram_size;
+    std::vector<std::uint8_t> payloads;
+    std::vector<Datagram> datagrams;
+    std::size_t datagram_count = 0;
+
+    bool gso_enabled = false;
+
+    std::uint8_t *get_payload(std::size_t index) { return payloads.data() + index * max_datagram_size; }
+
+#ifdef __linux__
+    // the kernel won't segment more than this many datagrams or bytes in one message
+    static constexpr std::size_t max_gso_segments = 64;
+    static constexpr std::size_t max_gso_bytes = 65000;
+
+    struct ControlBuffer {
+        alignas(cmsghdr) char data[CMSG_SPACE(sizeof(std::uint16_t))];
+    };
+
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> messages;
+    std::vector<std::size_t> message_first_datagram;
+    std::vector<ControlBuffer> control_buffers;
+
+    bool same_address(const Datagram &a, const Datagram &b) const {
+        return a.address_length == b.address_length && std::memcmp(&a.address, &b.address, a.address_length) == 0;
+    }
+
+    std::size_t get_message_end(std::size_t message_index, std::size_t message_count, std::size_t end) const {
+        return message_index + 1 < message_count ? message_first_datagram[message_index + 1] : end;
+    }
+
+    /**
+     * @brief fills in the mmsghdr array for the datagrams in [first, end), returns how many messages were made
+     */
+    std::size_t build_messages(std::size_t first, std::size_t end) {
+        std::size_t message_count = 0;
+        std::size_t i = first;
+        while (i < end) {
+            std::size_t run_end = i + 1;
+            if (gso_enabled) {
+                // every segment but the last has to be exactly the segment size
+                std::size_t run_bytes = datagrams[i].size;
+                while (run_end < end && run_end - i < max_gso_segments &&
+                       same_address(datagrams[i], datagrams[run_end]) && datagrams[run_end].size <= datagrams[i].size &&
+                       run_bytes + datagrams[run_end].size <= max_gso_bytes) {
+                    run_bytes += datagrams[run_end].size;
+                    run_end++;
+                    if (datagrams[run_end - 1].size < datagrams[i].size) {
+                        break;
+                    }
+                }
+            }
+
+            for (std::size_t j = i; j < run_end; j++) {
+                iovecs[j].iov_base = get_payload(j);
+                iovecs[j].iov_len = datagrams[j].size;
+            }
+
+            mmsghdr &message = messages[message_count];
+            std::memset(&message, 0, sizeof(message));
+            message.msg_hdr.msg_name = &datagrams[i].address;
+            message.msg_hdr.msg_namelen = datagrams[i].address_length;
+            message.msg_hdr.msg_iov = &iovecs[i];
+            message.msg_hdr.msg_iovlen = run_end - i;
+#ifdef UDP_SEGMENT
+            if (run_end - i > 1) {
+                ControlBuffer &control_buffer = control_buffers[message_count];
+                message.msg_hdr.msg_control = control_buffer.data;
+                message.msg_hdr.msg_controllen = sizeof(control_buffer.data);
+                cmsghdr *control_message = CMSG_FIRSTHDR(&message.msg_hdr);
+                control_message->cmsg_level = SOL_UDP;
+                control_message->cmsg_type = UDP_SEGMENT;
+                control_message->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+                std::uint16_t segment_size = static_cast<std::uint16_t>(datagrams[i].size);
+                std::memcpy(CMSG_DATA(control_message), &segment_size, sizeof(segment_size));
+            }
+#endif
+            message_first_datagram[message_count] = i;
+            message_count++;
+            i = run_end;
+        }
+        return message_count;
+    }
+#endif
+};
+
+#endif // DATAGRAM_QUEUE_HPP
@@ -0,0 +1,152 @@
+#ifndef IDLE_WAKER_HPP
+#define IDLE_WAKER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/**
+ * @brief lets other threads wake up a PeriodicSignal that has gone idle
+ *
+ * @details producers call @see notify whenever they hand the signal's thread some work, this is cheap when nobody is
+ * waiting, it's just an atomic exchange, the syscall only happens on the transition from not notified to notified.
+ * On linux this is backed by an eventfd, so @see get_fd can also be added to an epoll set if the thread waits on
+ * other things too.
+ *
+ * on linux the eventfd is the source of truth and the flag only saves syscalls: it's set before the eventfd is
+ * written and only cleared after the write has been read back, so while the flag is clear the eventfd is empty, and
+ * while it's set the eventfd is readable or a write is on its way. A notify that lands while the flag is still set
+ * skips its write, which is fine because the consumer clears the flag before it looks for work, so either it sees
+ * that notify's work or the notify sees the cleared flag and writes.
+ */
+class IdleWaker {
+  public:
+    IdleWaker() {
+#ifdef __linux__
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    }
+
+    IdleWaker(const IdleWaker &) = delete;
+    IdleWaker &operator=(const IdleWaker &) = delete;
+
+    ~IdleWaker() {
+#ifdef __linux__
+        if (event_fd >= 0) {
+            close(event_fd);
+        }
+#endif
+    }
+
+    /**
+     * @brief marks that there is work to do and wakes up the waiting thread, safe to call from any thread
+     */
+    void notify() {
+        if (notified.exchange(true)) {
+            return;
+        }
+#ifdef __linux__
+        std::uint64_t one = 1;
+        [[maybe_unused]] auto ignored = write(event_fd, &one, sizeof(one));
+#else
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        condition.notify_all();
+#endif
+    }
+
+    /**
+     * @brief returns true and clears the notification if there was one
+     *
+     * @note look for work after this returns true, not before, otherwise work handed over by a notify that was
+     * folded into this one can be missed
+     */
+    bool consume_notification() {
+#ifdef __linux__
+        if (!notified.load()) {
+            return false;
+        }
+        // if the notifier hasn't written yet leave the flag set, the eventfd becomes readable once it does
+        std::uint64_t count;
+        if (read(event_fd, &count, sizeof(count)) != sizeof(count)) {
+            return false;
+        }
+        notified.store(false);
+        return true;
+#else
+        return notified.load(std::memory_order_relaxed) && notified.exchange(false, std::memory_order_acq_rel);
+#endif
+    }
+
+    /**
+     * @brief blocks until notified or until the deadline, returns true if notified
+     *
+     * @note the notification is not consumed, call @see consume_notification for that
+     */
+    bool wait_until(std::chrono::steady_clock::time_point deadline) {
+#ifdef __linux__
+        while (true) {
+            pollfd event_poll{event_fd, POLLIN, 0};
+            int result;
+            if (deadline == std::chrono::steady_clock::time_point::max()) {
+                result = ::ppoll(&event_poll, 1, nullptr, nullptr);
+            } else {
+                auto remaining_nanoseconds = std::max<std::int64_t>(
+                    0, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now())
+                           .count());
+                timespec timeout{static_cast<time_t>(remaining_nanoseconds / 1000000000),
+                                 static_cast<long>(remaining_nanoseconds % 1000000000)};
+                result = ::ppoll(&event_poll, 1, &timeout, nullptr);
+            }
+            // anything else was a signal interrupting us, go back to waiting
+            if (result >= 0) {
+                return result > 0;
+            }
+        }
+#else
+        while (!notified.load(std::memory_order_acquire)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            if (deadline == std::chrono::steady_clock::time_point::max()) {
+                condition.wait(lock, [this] { return notified.load(std::memory_order_acquire); });
+            } else {
+                condition.wait_until(lock, deadline, [this] { return notified.load(std::memory_order_acquire); });
+            }
+        }
+        return true;
+#endif
+    }
+
+    /**
+     * @brief blocks until notified
+     */
+    void wait() { wait_until(std::chrono::steady_clock::time_point::max()); }
+
+#ifdef __linux__
+    int get_fd() const { return event_fd; }
+#endif
+
+  private:
+    std::atomic<bool> notified{false};
+#ifdef __linux__
+    int event_fd = -1;
+#else
+    std::mutex mutex;
+    std::condition_variable condition;
+#endif
+};
+
+#endif // IDLE_WAKER_HPP
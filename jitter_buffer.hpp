@@ -0,0 +1,297 @@
+#ifndef JITTER_BUFFER_HPP
+#define JITTER_BUFFER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief buffers packets which arrive with jitter so that they can be consumed at exactly one per tick
+ *
+ * @details every packet is tagged with the tick index it was produced on by the sender, and is stored in a fixed ring
+ * at tick_index % Capacity, so nothing is allocated after construction. Each time the local PeriodicSignal ticks the
+ * packet for the next playout tick is released.
+ *
+ * the playout tick trails the newest received tick by a target depth, instead of picking a fixed worst case depth we
+ * measure the arrival jitter (the same smoothed estimator rtp uses) and set the depth to cover a few multiples of it.
+ * When the buffer is deeper than it needs to be we skip a packet to catch up, and when a packet is missing and the
+ * buffer is shallower than it needs to be we hold for a tick instead of declaring it lost, so the depth changes one
+ * tick at a time.
+ *
+ * if the sender goes quiet for longer than the ring can cover, the next packet it sends would be too far ahead to be
+ * stored, so instead playout jumps forward to that packet and picks up at the target depth behind it.
+ *
+ * usage:
+ *
+ *     buffer.insert(packet.tick_index, packet); // whenever a packet arrives
+ *     ...
+ *     buffer.process([&](const Packet &packet) { apply(packet); });
+ *
+ * @note like TickArena this only looks at the signal's count and never calls process_and_get_signal
+ *
+ * @tparam Packet must be default constructible and copy assignable
+ * @tparam Capacity the number of ticks the ring can hold, this is also the max depth
+ */
+template <typename Packet, std::size_t Capacity> class JitterBuffer {
+    static_assert(Capacity >= 2, "a jitter buffer needs room for at least two ticks");
+
+  public:
+    enum class InsertResult {
+        accepted,
+        // the packet's tick has already been played out
+        late,
+        // we already have a packet for this tick
+        duplicate,
+    };
+
+    struct Statistics {
+        std::uint64_t accepted_count = 0;
+        std::uint64_t late_drop_count = 0;
+        std::uint64_t duplicate_drop_count = 0;
+        // packets so far ahead of playout that playout jumped forward to them, the ticks in between are dropped
+        std::uint64_t resync_count = 0;
+        std::uint64_t played_count = 0;
+        // playout ticks where the packet never arrived
+        std::uint64_t missing_count = 0;
+        // packets thrown away to reduce the depth
+        std::uint64_t skipped_count = 0;
+        // playout ticks where we waited instead of advancing to increase the depth
+        std::uint64_t held_count = 0;
+    };
+
+    /**
+     * @param sender_rate_hz the rate at which the sender produces ticks, usually the same as the local signal
+     * @param max_depth capped at Capacity - 1, and min_depth is lowered to it if it is larger
+     */
+    JitterBuffer(const PeriodicSignal &signal, int sender_rate_hz, std::size_t min_depth = 1,
+                 std::size_t max_depth = Capacity - 1)
+        : signal(signal), sender_period_seconds(1.0 / sender_rate_hz),
+          min_depth(std::min(min_depth, std::min(max_depth, Capacity - 1))),
+          max_depth(std::min(max_depth, Capacity - 1)), target_depth(this->min_depth),
+          observed_signal_count(signal.get_signal_count()) {}
+
+    /**
+     * @brief stores a packet that was produced on the given tick
+     */
+    InsertResult insert(std::int64_t tick_index, const Packet &packet,
+                        std::chrono::steady_clock::time_point arrival_time = std::chrono::steady_clock::now()) {
+        if (!started) {
+            started = true;
+            next_playout_tick = tick_index;
+            newest_tick = tick_index;
+            first_arrival_time = arrival_time;
+        }
+
+        update_jitter(tick_index, arrival_time);
+
+        if (tick_index < next_playout_tick) {
+            statistics.late_drop_count++;
+            return InsertResult::late;
+        }
+        if (tick_index >= next_playout_tick + static_cast<std::int64_t>(Capacity)) {
+            resync_to(tick_index);
+        }
+
+        Slot &slot = get_slot(tick_index);
+        if (slot.occupied && slot.tick_index == tick_index) {
+            statistics.duplicate_drop_count++;
+            return InsertResult::duplicate;
+        }
+        slot.packet = packet;
+        slot.tick_index = tick_index;
+        slot.occupied = true;
+        newest_tick = std::max(newest_tick, tick_index);
+        statistics.accepted_count++;
+        return InsertResult::accepted;
+    }
+
+    /**
+     * @brief runs one playout tick for every time the signal has ticked since the last call, and passes each packet
+     * that is released to on_packet(const Packet &) in tick order
+     *
+     * @details if the signal's count went backwards, eg because its timeline was moved with set_timeline_position, no
+     * playout ticks are run and the buffer carries on from the new count, packets are never played out twice
+     *
+     * @return how many playout ticks were run, which can be more than the number of packets released if a packet was
+     * missing or we held a tick
+     */
+    template <typename OnPacket> std::size_t process(OnPacket &&on_packet) {
+        int signal_count = signal.get_signal_count();
+        int elapsed_ticks = signal_count - observed_signal_count;
+        observed_signal_count = signal_count;
+        if (elapsed_ticks <= 0) {
+            return 0;
+        }
+
+        for (int i = 0; i < elapsed_ticks; i++) {
+            if (const Packet *packet = run_playout_tick()) {
+                on_packet(*packet);
+            }
+        }
+        return static_cast<std::size_t>(elapsed_ticks);
+    }
+
+    /**
+     * @brief the tick index that will be released on the next playout tick
+     */
+    std::int64_t get_next_playout_tick() const { return next_playout_tick; }
+
+    /**
+     * @brief the depth in ticks that the buffer is currently adapting towards
+     */
+    std::size_t get_target_depth() const { return target_depth; }
+
+    /**
+     * @brief the smoothed arrival jitter in seconds
+     */
+    double get_jitter_seconds() const { return jitter_seconds; }
+
+    /**
+     * @brief how many multiples of the measured jitter the depth has to cover, defaults to 3
+     */
+    void set_jitter_safety_factor(double factor) { jitter_safety_factor = factor; }
+
+    const Statistics &get_statistics() const { return statistics; }
+
+    /**
+     * @brief drops all packets and waits for the first packet to start playout again
+     */
+    void reset() {
+        for (Slot &slot : slots) {
+            slot.occupied = false;
+        }
+        started = false;
+        playing = false;
+        newest_tick = 0;
+        next_playout_tick = 0;
+        has_previous_transit = false;
+        jitter_seconds = 0;
+        target_depth = min_depth;
+    }
+
+  private:
+    struct Slot {
+        Packet packet{};
+        std::int64_t tick_index = 0;
+        bool occupied = false;
+    };
+
+    const PeriodicSignal &signal;
+    double sender_period_seconds;
+    std::size_t min_depth;
+    std::size_t max_depth;
+    std::size_t target_depth;
+    double jitter_safety_factor = 3.0;
+    int observed_signal_count;
+
+    std::array<Slot, Capacity> slots;
+    bool started = false;
+    bool playing = false;
+    std::int64_t next_playout_tick = 0;
+    std::int64_t newest_tick = 0;
+
+    std::chrono::steady_clock::time_point first_arrival_time;
+    bool has_previous_transit = false;
+    double previous_transit_seconds = 0;
+    double jitter_seconds = 0;
+
+    Statistics statistics;
+
+    Slot &get_slot(std::int64_t tick_index) {
+        std::int64_t capacity = static_cast<std::int64_t>(Capacity);
+        return slots[static_cast<std::size_t>(((tick_index % capacity) + capacity) % capacity)];
+    }
+
+    std::int64_t get_buffered_tick_count() const { return newest_tick - next_playout_tick + 1; }
+
+    /**
+     * @brief moves playout forward so that the given tick is target depth ticks out, dropping everything before it
+     *
+     * @details without this a sender that paused for Capacity ticks or more would have every later packet rejected,
+     * newest_tick would never move again and playout would hold forever
+     */
+    void resync_to(std::int64_t tick_index) {
+        std::int64_t depth = static_cast<std::int64_t>(std::max<std::size_t>(target_depth, 1));
+        next_playout_tick = tick_index - depth + 1;
+        for (Slot &slot : slots) {
+            if (slot.occupied && slot.tick_index < next_playout_tick) {
+                slot.occupied = false;
+            }
+        }
+        newest_tick = std::max(newest_tick, next_playout_tick - 1);
+        statistics.resync_count++;
+    }
+
+    /**
+     * @brief advances playout by one tick, returns the packet for it, or nullptr if it's missing or we're holding
+     *
+     * @note the packet stays valid until the next insert
+     */
+    const Packet *run_playout_tick() {
+        if (!started) {
+            return nullptr;
+        }
+
+        // wait until the buffer has filled up to the target depth before the first packet is played
+        if (!playing) {
+            if (get_buffered_tick_count() < static_cast<std::int64_t>(target_depth)) {
+                return nullptr;
+            }
+            playing = true;
+        }
+
+        // too much is buffered, drop one tick to bring the latency down
+        if (get_buffered_tick_count() > static_cast<std::int64_t>(target_depth) + 1) {
+            Slot &slot = get_slot(next_playout_tick);
+            if (slot.occupied && slot.tick_index == next_playout_tick) {
+                slot.occupied = false;
+                statistics.skipped_count++;
+            }
+            next_playout_tick++;
+        }
+
+        Slot &slot = get_slot(next_playout_tick);
+        if (slot.occupied && slot.tick_index == next_playout_tick) {
+            slot.occupied = false;
+            next_playout_tick++;
+            statistics.played_count++;
+            return &slot.packet;
+        }
+
+        // the packet isn't here and we don't have enough buffered, wait a tick for it to show up
+        if (get_buffered_tick_count() < static_cast<std::int64_t>(target_depth)) {
+            statistics.held_count++;
+            return nullptr;
+        }
+
+        next_playout_tick++;
+        statistics.missing_count++;
+        return nullptr;
+    }
+
+    /**
+     * @brief the rfc 3550 interarrival jitter estimate, the transit time is relative to the first arrival so the two
+     * clocks don't need to be synchronized
+     */
+    void update_jitter(std::int64_t tick_index, std::chrono::steady_clock::time_point arrival_time) {
+        double arrival_seconds = std::chrono::duration<double>(arrival_time - first_arrival_time).count();
+        double transit_seconds = arrival_seconds - static_cast<double>(tick_index) * sender_period_seconds;
+        if (has_previous_transit) {
+            double difference = std::abs(transit_seconds - previous_transit_seconds);
+            jitter_seconds += (difference - jitter_seconds) / 16.0;
+        }
+        previous_transit_seconds = transit_seconds;
+        has_previous_transit = true;
+
+        double jitter_ticks = jitter_safety_factor * jitter_seconds / sender_period_seconds;
+        std::size_t depth = min_depth + static_cast<std::size_t>(std::ceil(jitter_ticks));
+        target_depth = std::clamp(depth, min_depth, max_depth);
+    }
+};
+
+#endif // JITTER_BUFFER_HPP
@@ -0,0 +1,166 @@
+#ifndef LATE_START_PACER_HPP
+#define LATE_START_PACER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief starts each tick's work as late as possible so that input is sampled as close to the deadline as possible
+ *
+ * @details normally work starts right at the tick boundary, and whatever input was read at that point is a whole
+ * period old by the time the result is due at the next boundary. This pacer treats the next boundary of the signal as
+ * the deadline and starts the work at deadline - predicted work time - safety margin instead.
+ *
+ * the prediction is a high percentile of the recent work durations, so a single slow tick doesn't throw it off. When
+ * a deadline is missed the safety margin grows, and while deadlines are met it slowly shrinks back to the configured
+ * minimum, this way the pacer adapts to work that gets slower or more erratic.
+ *
+ * usage:
+ *
+ *     LateStartPacer pacer(signal);
+ *     while (running) {
+ *         pacer.wait_for_start();
+ *         sample_input();
+ *         simulate_and_render();
+ *         pacer.finish_work(); // waits for the deadline and consumes the signal
+ *         present();
+ *     }
+ *
+ * @note the pacer drives the signal itself through wait_for_signal, don't also call process_and_get_signal on it
+ */
+class LateStartPacer {
+  public:
+    struct Statistics {
+        std::uint64_t tick_count = 0;
+        std::uint64_t missed_deadline_count = 0;
+        // how much earlier than the deadline the work finished, summed over all ticks that made it
+        double total_slack_seconds = 0;
+
+        double get_miss_rate() const {
+            return tick_count == 0 ? 0 : static_cast<double>(missed_deadline_count) / tick_count;
+        }
+
+        double get_mean_slack_seconds() const {
+            std::uint64_t hit_count = tick_count - missed_deadline_count;
+            return hit_count == 0 ? 0 : total_slack_seconds / hit_count;
+        }
+    };
+
+    /**
+     * @param minimum_safety_margin the smallest gap left between the predicted end of the work and the deadline
+     * @param prediction_percentile which percentile of the recent work durations to plan for
+     */
+    explicit LateStartPacer(PeriodicSignal &signal,
+                            std::chrono::duration<double> minimum_safety_margin = std::chrono::microseconds(500),
+                            double prediction_percentile = 0.95, WaitStrategy wait_strategy = WaitStrategy::hybrid)
+        : signal(signal), minimum_safety_margin_seconds(minimum_safety_margin.count()),
+          safety_margin_seconds(minimum_safety_margin.count()), prediction_percentile(prediction_percentile),
+          wait_strategy(wait_strategy) {}
+
+    /**
+     * @brief blocks until it's time to start the work for the upcoming deadline, and returns that deadline
+     *
+     * @details before any work has been measured the prediction is a whole period, so the first tick starts right at
+     * the boundary like it would without the pacer
+     */
+    std::chrono::steady_clock::time_point wait_for_start() {
+        deadline = signal.get_next_signal_time();
+        auto start_time =
+            deadline - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(
+                           get_predicted_work_seconds() + safety_margin_seconds));
+
+        auto now = std::chrono::steady_clock::now();
+        if (start_time > now) {
+            if (wait_strategy == WaitStrategy::busy_poll) {
+                while (std::chrono::steady_clock::now() < start_time) {
+                }
+            } else if (wait_strategy == WaitStrategy::sleep) {
+                std::this_thread::sleep_until(start_time);
+            } else {
+                std::this_thread::sleep_until(start_time - spin_duration);
+                while (std::chrono::steady_clock::now() < start_time) {
+                }
+            }
+        }
+        work_start_time = std::chrono::steady_clock::now();
+        return deadline;
+    }
+
+    /**
+     * @brief records how long the work took, then waits for the deadline and consumes the signal
+     *
+     * @return true if the work finished before the deadline
+     */
+    bool finish_work() {
+        auto now = std::chrono::steady_clock::now();
+        record_work_duration(std::chrono::duration<double>(now - work_start_time).count());
+
+        bool met_deadline = now <= deadline;
+        statistics.tick_count++;
+        if (met_deadline) {
+            statistics.total_slack_seconds += std::chrono::duration<double>(deadline - now).count();
+            // slowly give back the margin that misses added, 1% per tick
+            safety_margin_seconds -= (safety_margin_seconds - minimum_safety_margin_seconds) * 0.01;
+        } else {
+            statistics.missed_deadline_count++;
+            safety_margin_seconds = std::min(safety_margin_seconds * 1.5, signal.get_period_seconds());
+        }
+
+        signal.wait_for_signal(wait_strategy, spin_duration);
+        return met_deadline;
+    }
+
+    /**
+     * @brief how long the pacer expects the work to take, the configured percentile of recent work durations
+     */
+    double get_predicted_work_seconds() const {
+        if (recorded_duration_count == 0) {
+            return signal.get_period_seconds();
+        }
+        std::size_t count = std::min(recorded_duration_count, history_length);
+        std::array<double, history_length> sorted_durations;
+        std::copy(work_durations.begin(), work_durations.begin() + count, sorted_durations.begin());
+        auto rank = static_cast<std::size_t>(prediction_percentile * static_cast<double>(count - 1));
+        std::nth_element(sorted_durations.begin(), sorted_durations.begin() + rank, sorted_durations.begin() + count);
+        return sorted_durations[rank];
+    }
+
+    double get_safety_margin_seconds() const { return safety_margin_seconds; }
+
+    /**
+     * @brief with the hybrid wait strategy, how long before the start time and the deadline we switch to spinning
+     */
+    void set_spin_duration(std::chrono::steady_clock::duration spin_duration) { this->spin_duration = spin_duration; }
+
+    const Statistics &get_statistics() const { return statistics; }
+
+  private:
+    static constexpr std::size_t history_length = 64;
+
+    PeriodicSignal &signal;
+    double minimum_safety_margin_seconds;
+    double safety_margin_seconds;
+    double prediction_percentile;
+    WaitStrategy wait_strategy;
+    std::chrono::steady_clock::duration spin_duration = std::chrono::microseconds(200);
+
+    std::array<double, history_length> work_durations = {};
+    std::size_t recorded_duration_count = 0;
+
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point work_start_time;
+    Statistics statistics;
+
+    void record_work_duration(double seconds) {
+        work_durations[recorded_duration_count % history_length] = seconds;
+        recorded_duration_count++;
+    }
+};
+
+#endif // LATE_START_PACER_HPP
@@ -0,0 +1,94 @@
+#ifndef LAZY_PERIODIC_TIMER_HPP
+#define LAZY_PERIODIC_TIMER_HPP
+
+#include <algorithm>
+#include <chrono>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief a periodic timer that is never polled, it works out how many ticks went by only when it's looked at
+ *
+ * @details this is meant for huge numbers of things that each have some periodic state but only rarely need it, eg
+ * health regeneration, decay or cooldowns on millions of entities. Instead of sweeping every entity every frame each
+ * one stores a tiny @see State, the anchor of its timeline and the last tick it consumed, and whenever the entity is
+ * touched @see consume_ticks tells you in O(1) how many ticks passed since it was last touched.
+ *
+ * the rate is shared by every entity of the same kind so it lives here and not in the state. The ticks are laid out
+ * on the same timeline as a PeriodicSignal, tick n is at anchor + n * period.
+ *
+ * usage:
+ *
+ *     LazyPeriodicTimer regeneration_timer(2); // 2 hp per second
+ *     entity.regeneration = regeneration_timer.start(now);
+ *     ...
+ *     // when the entity is looked at
+ *     entity.health = std::min(max_health, entity.health + regeneration_timer.consume_ticks(entity.regeneration, now));
+ */
+class LazyPeriodicTimer {
+  public:
+    struct State {
+        std::chrono::steady_clock::time_point anchor;
+        long long last_consumed_tick = 0;
+    };
+
+    explicit LazyPeriodicTimer(int rate_hz) : period_duration(1.0 / rate_hz) {}
+
+    explicit LazyPeriodicTimer(std::chrono::duration<double> period_duration) : period_duration(period_duration) {}
+
+    /**
+     * @brief a state whose timeline starts at the given time, the first tick is one period later
+     */
+    State start(std::chrono::steady_clock::time_point anchor) const { return {anchor, 0}; }
+
+    /**
+     * @brief puts an existing state back to the start of a new timeline, eg when a cooldown is triggered again
+     */
+    void restart(State &state, std::chrono::steady_clock::time_point anchor) const { state = start(anchor); }
+
+    /**
+     * @brief how many ticks have passed since the last consumed one, without consuming them
+     */
+    long long get_elapsed_tick_count(const State &state, std::chrono::steady_clock::time_point now) const {
+        return std::max(0LL, get_tick_index(state, now) - state.last_consumed_tick);
+    }
+
+    /**
+     * @brief returns how many ticks have passed since the last consumed one and marks them as consumed
+     */
+    long long consume_ticks(State &state, std::chrono::steady_clock::time_point now) const {
+        long long tick_index = get_tick_index(state, now);
+        long long elapsed_tick_count = std::max(0LL, tick_index - state.last_consumed_tick);
+        state.last_consumed_tick = std::max(state.last_consumed_tick, tick_index);
+        return elapsed_tick_count;
+    }
+
+    /**
+     * @brief the index of the tick the state's timeline is in at the given time, negative before the anchor
+     */
+    long long get_tick_index(const State &state, std::chrono::steady_clock::time_point now) const {
+        return periodic_timeline::get_tick_index(state.anchor, period_duration, now);
+    }
+
+    /**
+     * @brief progress [0,1] through the current tick
+     */
+    double get_phase(const State &state, std::chrono::steady_clock::time_point now) const {
+        return periodic_timeline::get_phase(state.anchor, period_duration, now);
+    }
+
+    /**
+     * @brief when the tick after the last consumed one happens, this is when the next tick can be consumed
+     */
+    std::chrono::steady_clock::time_point get_next_tick_time(const State &state) const {
+        return periodic_timeline::get_time_point_at_cycles(state.anchor, period_duration,
+                                                           static_cast<double>(state.last_consumed_tick + 1));
+    }
+
+    double get_period_seconds() const { return period_duration.count(); }
+
+  private:
+    std::chrono::duration<double> period_duration;
+};
+
+#endif // LAZY_PERIODIC_TIMER_HPP
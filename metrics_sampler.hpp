@@ -0,0 +1,548 @@
+#ifndef METRICS_SAMPLER_HPP
+#define METRICS_SAMPLER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief a list of counters and gauges that a MetricsSampler reads on every tick
+ *
+ * @details the registry only stores pointers, the subsystems keep owning their atomics and keep updating them however
+ * they like. Counters are monotonic and are sampled as the increase since the previous sample, gauges are sampled as
+ * is.
+ *
+ * @note everything has to be registered before the sampler is constructed, the sampler sizes its storage off of the
+ * number of metrics in here
+ */
+class MetricsRegistry {
+  public:
+    enum class MetricKind {
+        counter,
+        gauge,
+    };
+
+    std::size_t add_counter(std::string name, const std::atomic<std::int64_t> *counter) {
+        metrics.push_back({std::move(name), MetricKind::counter, counter, nullptr});
+        return metrics.size() - 1;
+    }
+
+    std::size_t add_gauge(std::string name, const std::atomic<double> *gauge) {
+        metrics.push_back({std::move(name), MetricKind::gauge, nullptr, gauge});
+        return metrics.size() - 1;
+    }
+
+    std::size_t size() const { return metrics.size(); }
+
+    const std::string &get_name(std::size_t metric_index) const { return metrics[metric_index].name; }
+
+    MetricKind get_kind(std::size_t metric_index) const { return metrics[metric_index].kind; }
+
+    /**
+     * @brief the raw value of the metric right now
+     */
+    double read(std::size_t metric_index) const {
+        const Metric &metric = metrics[metric_index];
+        if (metric.kind == MetricKind::counter) {
+            return static_cast<double>(metric.counter->load(std::memory_order_relaxed));
+        }
+        return metric.gauge->load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Metric {
+        std::string name;
+        MetricKind kind;
+        const std::atomic<std::int64_t> *counter;
+        const std::atomic<double> *gauge;
+    };
+
+    std::vector<Metric> metrics;
+};
+
+/**
+ * @brief the resolutions that a MetricsSampler rolls its samples up into
+ */
+enum class RollupResolution {
+    one_second,
+    ten_seconds,
+    sixty_seconds,
+};
+
+/**
+ * @brief the min, max and mean of a metric over one rollup window
+ *
+ * @details a window in which no sample was taken, eg because the loop stalled, has a sample count of 0 and nan for
+ * everything else
+ */
+struct RollupPoint {
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    std::uint64_t sample_count = 0;
+};
+
+/**
+ * @brief the most recently closed window of every metric at every resolution, @see MetricsSampler::read_snapshot
+ */
+struct MetricsSnapshot {
+    // per resolution, how many windows have been closed so far, while it's 0 the points are meaningless
+    std::uint64_t closed_window_counts[3] = {};
+    // per resolution, where the window starts in seconds on the signal's timeline
+    double window_start_seconds[3] = {};
+    // resolution major, one point per metric for every resolution
+    std::vector<RollupPoint> points;
+
+    const RollupPoint &get_point(std::size_t metric_index, RollupResolution resolution) const {
+        return points[static_cast<std::size_t>(resolution) * (points.size() / 3) + metric_index];
+    }
+};
+
+/**
+ * @brief samples every metric in a MetricsRegistry once per tick and rolls the samples up into 1s, 10s and 60s series
+ *
+ * @details windows are measured on the signal's timeline, not by counting samples: tick n is n periods after the
+ * signal started, and its sample belongs to the second that time falls in. If ticks are missed, or the signal is
+ * idle and strides over several ticks, a 1s window holds fewer samples but still covers one second, and a window with
+ * no samples at all is closed empty.
+ *
+ * all storage is allocated in the constructor. Raw samples are kept until their second is over, laid out metric major
+ * so that every metric's samples are one contiguous array, and are then reduced into a 1s point. Every closed window
+ * is also folded into the open window of the next resolution, so the 10s and 60s windows never have to look at raw
+ * samples again, and their mean is weighted by how many samples each second actually had.
+ *
+ * the reductions of the raw samples are plain loops over contiguous doubles with several independent accumulators,
+ * which is the shape the compiler's auto-vectorizer turns into simd min/max/add instructions.
+ *
+ * like TickArena this only looks at the signal's count and never calls process_and_get_signal.
+ *
+ * every time a window closes the latest point of every resolution is published through a seqlock, so an exporter on
+ * another thread can read them with @see read_snapshot.
+ *
+ * @note everything except @see read_snapshot has to be called from the thread that calls @see process
+ */
+class MetricsSampler {
+  public:
+    /**
+     * @param series_length how many rollup points to keep for each resolution
+     */
+    MetricsSampler(const PeriodicSignal &signal, const MetricsRegistry &registry, std::size_t series_length = 60)
+        : signal(signal), registry(registry), metric_count(registry.size()),
+          raw_sample_capacity(get_max_samples_per_second(signal)), raw_samples(metric_count * raw_sample_capacity),
+          previous_raw_values(metric_count), latest_samples(metric_count),
+          published_word_count(3 * (published_header_word_count + 3 * metric_count)),
+          published_words(new std::atomic<std::uint64_t>[published_word_count]),
+          observed_signal_count(signal.get_signal_count()) {
+        series_length = std::max<std::size_t>(series_length, 1);
+        for (Series &series : series_by_resolution) {
+            series.capacity = series_length;
+            series.mins.resize(metric_count * series_length);
+            series.maxes.resize(metric_count * series_length);
+            series.means.resize(metric_count * series_length);
+            series.sample_counts.resize(series_length);
+            series.pending_mins.resize(metric_count);
+            series.pending_maxes.resize(metric_count);
+            series.pending_sums.resize(metric_count);
+            reset_pending(series);
+        }
+        for (std::size_t metric_index = 0; metric_index < metric_count; metric_index++) {
+            previous_raw_values[metric_index] = registry.read(metric_index);
+        }
+        for (std::size_t i = 0; i < published_word_count; i++) {
+            published_words[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    MetricsSampler(const MetricsSampler &) = delete;
+    MetricsSampler &operator=(const MetricsSampler &) = delete;
+
+    /**
+     * @brief takes a sample if the signal has ticked since the last call, returns true if it did
+     */
+    bool process() {
+        int signal_count = signal.get_signal_count();
+        if (signal_count == observed_signal_count) {
+            return false;
+        }
+        observed_signal_count = signal_count;
+        sample();
+        return true;
+    }
+
+    /**
+     * @brief takes a sample right now, attributed to the signal's current tick, normally you'd let @see process call
+     * this once per tick
+     *
+     * @note if the signal's count goes backwards, eg because its timeline was moved with set_timeline_position, the
+     * samples keep going into the open window until the timeline is past it again
+     */
+    void sample() {
+        std::int64_t tick_index = signal.get_signal_count();
+        std::int64_t window_index = get_one_second_window_index(tick_index);
+        Series &one_second = get_series(RollupResolution::one_second);
+        bool closed_window = false;
+        if (!has_window) {
+            start_windows(window_index);
+        } else if (window_index > one_second.window_index) {
+            // the ticks since the last sample crossed into a later second
+            close_window(0, window_index);
+            closed_window = true;
+        }
+
+        if (raw_sample_count == raw_sample_capacity) {
+            // only happens if sample is called more often than the signal ticks
+            fold_raw_samples();
+        }
+        for (std::size_t metric_index = 0; metric_index < metric_count; metric_index++) {
+            double raw_value = registry.read(metric_index);
+            double value = raw_value;
+            if (registry.get_kind(metric_index) == MetricsRegistry::MetricKind::counter) {
+                value = raw_value - previous_raw_values[metric_index];
+                previous_raw_values[metric_index] = raw_value;
+            }
+            raw_samples[metric_index * raw_sample_capacity + raw_sample_count] = value;
+            latest_samples[metric_index] = value;
+        }
+        raw_sample_count++;
+
+        // close the second as soon as its last tick is in instead of waiting for the first sample of the next one
+        std::int64_t next_window_index = get_one_second_window_index(tick_index + 1);
+        if (next_window_index > one_second.window_index) {
+            close_window(0, next_window_index);
+            closed_window = true;
+        }
+        if (closed_window) {
+            publish_snapshot();
+        }
+    }
+
+    std::size_t get_metric_count() const { return metric_count; }
+
+    /**
+     * @brief the value of the metric in the most recent sample, for counters this is the increase during that tick
+     */
+    double get_latest_sample(std::size_t metric_index) const { return latest_samples[metric_index]; }
+
+    /**
+     * @brief the number of rollup points available at the given resolution, this maxes out at the series length
+     */
+    std::size_t get_rollup_count(RollupResolution resolution) const {
+        const Series &series = get_series(resolution);
+        return std::min(series.written_count, series.capacity);
+    }
+
+    /**
+     * @brief returns a rollup point of the metric, age 0 is the most recent window, age 1 the one before that and so on
+     *
+     * @note age has to be less than @see get_rollup_count
+     */
+    RollupPoint get_rollup(std::size_t metric_index, RollupResolution resolution, std::size_t age = 0) const {
+        const Series &series = get_series(resolution);
+        std::size_t position = (series.written_count - 1 - age) % series.capacity;
+        std::size_t index = metric_index * series.capacity + position;
+        return {series.mins[index], series.maxes[index], series.means[index], series.sample_counts[position]};
+    }
+
+    /**
+     * @brief copies the most recently closed window of every metric at every resolution, safe to call from any thread
+     *
+     * @return false if the sampler kept publishing for every attempt, the snapshot is left half written then
+     */
+    bool read_snapshot(MetricsSnapshot &snapshot, int max_attempts = 1000) const {
+        snapshot.points.resize(3 * metric_count);
+        for (int attempt = 0; attempt < max_attempts; attempt++) {
+            std::uint64_t sequence_before = published_sequence.load(std::memory_order_acquire);
+            if (sequence_before % 2 == 1) {
+                continue;
+            }
+            for (std::size_t resolution = 0; resolution < 3; resolution++) {
+                std::size_t word = resolution * (published_header_word_count + 3 * metric_count);
+                snapshot.closed_window_counts[resolution] = load_published_word(word);
+                snapshot.window_start_seconds[resolution] = to_double(load_published_word(word + 1));
+                std::uint64_t sample_count = load_published_word(word + 2);
+                word += published_header_word_count;
+                for (std::size_t metric_index = 0; metric_index < metric_count; metric_index++) {
+                    RollupPoint &point = snapshot.points[resolution * metric_count + metric_index];
+                    point.min = to_double(load_published_word(word++));
+                    point.max = to_double(load_published_word(word++));
+                    point.mean = to_double(load_published_word(word++));
+                    point.sample_count = sample_count;
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (published_sequence.load(std::memory_order_relaxed) == sequence_before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    /**
+     * @brief a ring of closed windows for every metric, stored metric major as separate min, max and mean arrays,
+     * plus the window that is still open
+     */
+    struct Series {
+        std::size_t capacity = 0;
+        std::size_t written_count = 0;
+        std::vector<double> mins;
+        std::vector<double> maxes;
+        std::vector<double> means;
+        std::vector<std::uint64_t> sample_counts;
+
+        // the open window, in units of this resolution's window length on the signal's timeline
+        std::int64_t window_index = 0;
+        std::vector<double> pending_mins;
+        std::vector<double> pending_maxes;
+        std::vector<double> pending_sums;
+        std::uint64_t pending_sample_count = 0;
+    };
+
+    // how many windows of one resolution make up a window of the next one
+    static constexpr std::int64_t windows_per_next_resolution[2] = {10, 6};
+    static constexpr double window_seconds[3] = {1, 10, 60};
+    // closed window count, window start and sample count come before every resolution's points
+    static constexpr std::size_t published_header_word_count = 3;
+
+    const PeriodicSignal &signal;
+    const MetricsRegistry &registry;
+    std::size_t metric_count;
+    std::size_t raw_sample_capacity;
+    std::vector<double> raw_samples;
+    std::size_t raw_sample_count = 0;
+    std::vector<double> previous_raw_values;
+    std::vector<double> latest_samples;
+    Series series_by_resolution[3];
+    bool has_window = false;
+
+    std::size_t published_word_count;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> published_words;
+    std::atomic<std::uint64_t> published_sequence{0};
+
+    int observed_signal_count;
+
+    /**
+     * @brief an upper bound on the ticks that fall in one second of the timeline
+     */
+    static std::size_t get_max_samples_per_second(const PeriodicSignal &signal) {
+        return static_cast<std::size_t>(std::ceil(1.0 / signal.get_period_seconds())) + 1;
+    }
+
+    std::int64_t get_one_second_window_index(std::int64_t tick_index) const {
+        // the nudge keeps a tick that lands exactly on a second boundary from rounding into the previous second
+        double tick_seconds = static_cast<double>(tick_index) * signal.get_period_seconds();
+        return static_cast<std::int64_t>(std::floor(tick_seconds + 1e-9));
+    }
+
+    static std::int64_t floor_divide(std::int64_t a, std::int64_t b) {
+        std::int64_t quotient = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? quotient - 1 : quotient;
+    }
+
+    const Series &get_series(RollupResolution resolution) const {
+        return series_by_resolution[static_cast<int>(resolution)];
+    }
+
+    Series &get_series(RollupResolution resolution) { return series_by_resolution[static_cast<int>(resolution)]; }
+
+    void start_windows(std::int64_t one_second_window_index) {
+        has_window = true;
+        std::int64_t window_index = one_second_window_index;
+        for (std::size_t level = 0; level < 3; level++) {
+            series_by_resolution[level].window_index = window_index;
+            if (level < 2) {
+                window_index = floor_divide(window_index, windows_per_next_resolution[level]);
+            }
+        }
+    }
+
+    static void reset_pending(Series &series) {
+        std::fill(series.pending_mins.begin(), series.pending_mins.end(), std::numeric_limits<double>::infinity());
+        std::fill(series.pending_maxes.begin(), series.pending_maxes.end(), -std::numeric_limits<double>::infinity());
+        std::fill(series.pending_sums.begin(), series.pending_sums.end(), 0.0);
+        series.pending_sample_count = 0;
+    }
+
+    /**
+     * @brief reduces the raw samples into the open 1s window and empties the raw sample buffer
+     */
+    void fold_raw_samples() {
+        if (raw_sample_count == 0) {
+            return;
+        }
+        Series &one_second = get_series(RollupResolution::one_second);
+        for (std::size_t metric_index = 0; metric_index < metric_count; metric_index++) {
+            const double *samples = &raw_samples[metric_index * raw_sample_capacity];
+            one_second.pending_mins[metric_index] =
+                std::min(one_second.pending_mins[metric_index], reduce_min(samples, raw_sample_count));
+            one_second.pending_maxes[metric_index] =
+                std::max(one_second.pending_maxes[metric_index], reduce_max(samples, raw_sample_count));
+            one_second.pending_sums[metric_index] += reduce_sum(samples, raw_sample_count);
+        }
+        one_second.pending_sample_count += raw_sample_count;
+        raw_sample_count = 0;
+    }
+
+    /**
+     * @brief closes the open window of the given resolution, closes the windows that were skipped empty, and opens
+     * next_window_index, the next resolution is closed too if this crossed one of its boundaries
+     */
+    void close_window(std::size_t level, std::int64_t next_window_index) {
+        Series &series = series_by_resolution[level];
+        if (level == 0) {
+            fold_raw_samples();
+        }
+
+        push_pending_window(series);
+        if (level < 2 && series.pending_sample_count != 0) {
+            Series &next_series = series_by_resolution[level + 1];
+            for (std::size_t metric_index = 0; metric_index < metric_count; metric_index++) {
+                next_series.pending_mins[metric_index] =
+                    std::min(next_series.pending_mins[metric_index], series.pending_mins[metric_index]);
+                next_series.pending_maxes[metric_index] =
+                    std::max(next_series.pending_maxes[metric_index], series.pending_maxes[metric_index]);
+                next_series.pending_sums[metric_index] += series.pending_sums[metric_index];
+            }
+            next_series.pending_sample_count += series.pending_sample_count;
+        }
+        reset_pending(series);
+
+        // windows that went by without a sample, only the ones that still fit in the ring have to be written
+        auto skipped_count = static_cast<std::size_t>(next_window_index - series.window_index - 1);
+        std::size_t written_skipped_count = std::min(skipped_count, series.capacity);
+        series.written_count += skipped_count - written_skipped_count;
+        for (std::size_t i = 0; i < written_skipped_count; i++) {
+            push_pending_window(series);
+        }
+
+        std::int64_t previous_window_index = series.window_index;
+        series.window_index = next_window_index;
+        if (level < 2) {
+            std::int64_t factor = windows_per_next_resolution[level];
+            std::int64_t next_level_window_index = floor_divide(next_window_index, factor);
+            if (next_level_window_index != floor_divide(previous_window_index, factor)) {
+                close_window(level + 1, next_level_window_index);
+            }
+        }
+    }
+
+    /**
+     * @brief writes the open window into the ring as the newest point, nan if it has no samples
+     */
+    void push_pending_window(Series &series) {
+        std::size_t position = series.written_count % series.capacity;
+        double count = static_cast<double>(series.pending_sample_count);
+        bool empty = series.pending_sample_count == 0;
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        for (std::size_t metric_index = 0; metric_index < metric_count; metric_index++) {
+            std::size_t index = metric_index * series.capacity + position;
+            series.mins[index] = empty ? nan : series.pending_mins[metric_index];
+            series.maxes[index] = empty ? nan : series.pending_maxes[metric_index];
+            series.means[index] = empty ? nan : series.pending_sums[metric_index] / count;
+        }
+        series.sample_counts[position] = series.pending_sample_count;
+        series.written_count++;
+    }
+
+    static std::uint64_t to_word(double value) {
+        std::uint64_t word;
+        std::memcpy(&word, &value, sizeof(word));
+        return word;
+    }
+
+    static double to_double(std::uint64_t word) {
+        double value;
+        std::memcpy(&value, &word, sizeof(value));
+        return value;
+    }
+
+    std::uint64_t load_published_word(std::size_t word) const {
+        return published_words[word].load(std::memory_order_relaxed);
+    }
+
+    void store_published_word(std::size_t word, std::uint64_t value) {
+        published_words[word].store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief writes the newest closed window of every resolution under the seqlock, the same way StatsSegment does
+     */
+    void publish_snapshot() {
+        std::uint64_t sequence = published_sequence.load(std::memory_order_relaxed);
+        published_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t level = 0; level < 3; level++) {
+            const Series &series = series_by_resolution[level];
+            std::size_t word = level * (published_header_word_count + 3 * metric_count);
+            store_published_word(word, series.written_count);
+            if (series.written_count == 0) {
+                continue;
+            }
+            std::size_t position = (series.written_count - 1) % series.capacity;
+            double window_start_seconds = static_cast<double>(series.window_index - 1) * window_seconds[level];
+            store_published_word(word + 1, to_word(window_start_seconds));
+            store_published_word(word + 2, series.sample_counts[position]);
+            word += published_header_word_count;
+            for (std::size_t metric_index = 0; metric_index < metric_count; metric_index++) {
+                std::size_t index = metric_index * series.capacity + position;
+                store_published_word(word++, to_word(series.mins[index]));
+                store_published_word(word++, to_word(series.maxes[index]));
+                store_published_word(word++, to_word(series.means[index]));
+            }
+        }
+        published_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    static double reduce_min(const double *values, std::size_t count) {
+        double lanes[4] = {values[0], values[0], values[0], values[0]};
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            for (int lane = 0; lane < 4; lane++) {
+                lanes[lane] = values[i + lane] < lanes[lane] ? values[i + lane] : lanes[lane];
+            }
+        }
+        for (; i < count; i++) {
+            lanes[0] = values[i] < lanes[0] ? values[i] : lanes[0];
+        }
+        return std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    }
+
+    static double reduce_max(const double *values, std::size_t count) {
+        double lanes[4] = {values[0], values[0], values[0], values[0]};
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            for (int lane = 0; lane < 4; lane++) {
+                lanes[lane] = values[i + lane] > lanes[lane] ? values[i + lane] : lanes[lane];
+            }
+        }
+        for (; i < count; i++) {
+            lanes[0] = values[i] > lanes[0] ? values[i] : lanes[0];
+        }
+        return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+
+    static double reduce_sum(const double *values, std::size_t count) {
+        double lanes[4] = {0, 0, 0, 0};
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            for (int lane = 0; lane < 4; lane++) {
+                lanes[lane] += values[i + lane];
+            }
+        }
+        for (; i < count; i++) {
+            lanes[0] += values[i];
+        }
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+};
+
+#endif // METRICS_SAMPLER_HPP
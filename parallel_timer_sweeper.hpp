@@ -0,0 +1,305 @@
+#ifndef PARALLEL_TIMER_SWEEPER_HPP
+#define PARALLEL_TIMER_SWEEPER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief hands out storage that starts on a cache line boundary, so that an array's cache lines line up with its
+ * elements and a partition boundary which is a whole number of cache lines in really is one
+ */
+template <typename T> struct CacheLineAlignedAllocator {
+    using value_type = T;
+
+    static constexpr std::size_t alignment = 64;
+
+    CacheLineAlignedAllocator() = default;
+    template <typename U> CacheLineAlignedAllocator(const CacheLineAlignedAllocator<U> &) {}
+
+    T *allocate(std::size_t count) {
+        return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(alignment)));
+    }
+
+    void deallocate(T *pointer, std::size_t) { ::operator delete(pointer, std::align_val_t(alignment)); }
+
+    template <typename U> bool operator==(const CacheLineAlignedAllocator<U> &) const { return true; }
+    template <typename U> bool operator!=(const CacheLineAlignedAllocator<U> &) const { return false; }
+};
+
+template <typename T> using CacheLineAlignedVector = std::vector<T, CacheLineAlignedAllocator<T>>;
+
+/**
+ * @brief a large number of periodic timers stored as a struct of arrays, eg one per entity
+ *
+ * @details every timer is laid out on the same kind of timeline as a PeriodicSignal or LazyPeriodicTimer, tick n is at
+ * anchor + n * period, and remembers the last tick it consumed. Times are stored as seconds since the population's
+ * epoch so that a sweep is plain arithmetic on doubles.
+ */
+class TimerPopulation {
+  public:
+    using TimerIndex = std::uint32_t;
+
+    explicit TimerPopulation(std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now())
+        : epoch(epoch) {}
+
+    void reserve(std::size_t timer_count) {
+        anchor_seconds.reserve(timer_count);
+        period_seconds.reserve(timer_count);
+        last_consumed_ticks.reserve(timer_count);
+        phases.reserve(timer_count);
+    }
+
+    /**
+     * @brief adds a timer whose first tick is one period after the anchor
+     *
+     * @throws std::invalid_argument if the period isn't positive
+     */
+    TimerIndex add_timer(std::chrono::steady_clock::time_point anchor, std::chrono::duration<double> period) {
+        // written this way round so that a nan period is rejected too
+        if (!(period.count() > 0)) {
+            throw std::invalid_argument("a timer's period has to be positive");
+        }
+        anchor_seconds.push_back(to_seconds(anchor));
+        period_seconds.push_back(period.count());
+        last_consumed_ticks.push_back(0);
+        phases.push_back(0);
+        return static_cast<TimerIndex>(anchor_seconds.size() - 1);
+    }
+
+    /**
+     * @brief starts the timer's timeline over at the given anchor
+     */
+    void restart_timer(TimerIndex timer_index, std::chrono::steady_clock::time_point anchor) {
+        anchor_seconds[timer_index] = to_seconds(anchor);
+        last_consumed_ticks[timer_index] = 0;
+        phases[timer_index] = 0;
+    }
+
+    std::size_t size() const { return anchor_seconds.size(); }
+
+    /**
+     * @brief progress [0,1) through the timer's current tick as of the last sweep
+     */
+    float get_phase(TimerIndex timer_index) const { return phases[timer_index]; }
+
+    std::int64_t get_last_consumed_tick(TimerIndex timer_index) const { return last_consumed_ticks[timer_index]; }
+
+    double to_seconds(std::chrono::steady_clock::time_point time_point) const {
+        return std::chrono::duration<double>(time_point - epoch).count();
+    }
+
+  private:
+    friend class ParallelTimerSweeper;
+
+    std::chrono::steady_clock::time_point epoch;
+    CacheLineAlignedVector<double> anchor_seconds;
+    CacheLineAlignedVector<double> period_seconds;
+    CacheLineAlignedVector<std::int64_t> last_consumed_ticks;
+    CacheLineAlignedVector<float> phases;
+};
+
+/**
+ * @brief sweeps a TimerPopulation on a pool of persistent worker threads, finding every timer that has ticked
+ *
+ * @details the population is split into one contiguous partition per thread, the calling thread takes the first one
+ * and the workers the rest. Every thread evaluates its timers against the same timestamp, writes their phase,
+ * consumes the ticks of the ones that are due and appends their indices to its own output list. Partitions don't
+ * overlap, the per timer arrays start on a cache line and partition boundaries are rounded to whole cache lines, so
+ * the inner loop needs no atomics and threads never write to the same cache line. The only synchronization is waking
+ * the workers up and waiting for them to finish, once per sweep.
+ *
+ * the inner loop is split in two passes over the partition, the first one is pure arithmetic (tick index, phase,
+ * due-ness) so it can be auto vectorized, the second compacts the due timers into the output list without branching.
+ *
+ * usage:
+ *
+ *     ParallelTimerSweeper sweeper(std::thread::hardware_concurrency());
+ *     while (running) {
+ *         if (signal.process_and_get_signal()) {
+ *             sweeper.sweep(population, std::chrono::steady_clock::now());
+ *             sweeper.for_each_fired([&](TimerPopulation::TimerIndex timer_index, std::int64_t elapsed_ticks) {
+ *                 regenerate(entities[timer_index], elapsed_ticks);
+ *             });
+ *         }
+ *     }
+ *
+ * @note the population must not be resized while a sweep is running, and only one thread may call sweep
+ */
+class ParallelTimerSweeper {
+  public:
+    explicit ParallelTimerSweeper(std::size_t thread_count) : outputs(std::max<std::size_t>(1, thread_count)) {
+        for (std::size_t worker_index = 1; worker_index < outputs.size(); worker_index++) {
+            workers.emplace_back([this, worker_index] { run_worker(worker_index); });
+        }
+    }
+
+    ParallelTimerSweeper(const ParallelTimerSweeper &) = delete;
+    ParallelTimerSweeper &operator=(const ParallelTimerSweeper &) = delete;
+
+    ~ParallelTimerSweeper() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start_condition.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief evaluates every timer at now, consuming the ticks of the ones that are due, returns how many were due
+     */
+    std::size_t sweep(TimerPopulation &population, std::chrono::steady_clock::time_point now) {
+        sweep_population = &population;
+        sweep_now_seconds = population.to_seconds(now);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            remaining_worker_count = workers.size();
+            sweep_generation++;
+        }
+        start_condition.notify_all();
+
+        sweep_partition(0);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done_condition.wait(lock, [this] { return remaining_worker_count == 0; });
+        }
+
+        std::size_t fired_count = 0;
+        for (const WorkerOutput &output : outputs) {
+            fired_count += output.fired_count;
+        }
+        return fired_count;
+    }
+
+    /**
+     * @brief calls on_fired(timer_index, elapsed_ticks) for every timer that was due in the last sweep, in index order
+     */
+    template <typename OnFired> void for_each_fired(OnFired &&on_fired) const {
+        for (const WorkerOutput &output : outputs) {
+            for (std::size_t i = 0; i < output.fired_count; i++) {
+                on_fired(output.fired_timer_indices[i], output.elapsed_tick_counts[i]);
+            }
+        }
+    }
+
+    std::size_t get_thread_count() const { return outputs.size(); }
+
+  private:
+    // a cache line worth of the smallest per timer array element, partition boundaries are multiples of this, which
+    // is a whole number of cache lines for the wider arrays too
+    static constexpr std::size_t partition_alignment = 64 / sizeof(float);
+
+    // well inside of what an int64 can hold, and exactly representable as doubles
+    static constexpr double min_tick_index = -4611686018427387904.0;
+    static constexpr double max_tick_index = 4611686018427387904.0;
+
+    struct alignas(64) WorkerOutput {
+        // separate allocations, so keep them off each other's cache lines too
+        CacheLineAlignedVector<TimerPopulation::TimerIndex> fired_timer_indices;
+        CacheLineAlignedVector<std::int64_t> elapsed_tick_counts;
+        CacheLineAlignedVector<std::int64_t> tick_indices;
+        std::size_t fired_count = 0;
+    };
+
+    std::vector<WorkerOutput> outputs;
+    std::vector<std::thread> workers;
+
+    TimerPopulation *sweep_population = nullptr;
+    double sweep_now_seconds = 0;
+
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+    std::uint64_t sweep_generation = 0;
+    std::size_t remaining_worker_count = 0;
+    bool stopping = false;
+
+    void run_worker(std::size_t worker_index) {
+        std::uint64_t observed_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start_condition.wait(lock, [&] { return stopping || sweep_generation != observed_generation; });
+                if (stopping) {
+                    return;
+                }
+                observed_generation = sweep_generation;
+            }
+
+            sweep_partition(worker_index);
+
+            bool last_worker;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                last_worker = --remaining_worker_count == 0;
+            }
+            if (last_worker) {
+                done_condition.notify_one();
+            }
+        }
+    }
+
+    void sweep_partition(std::size_t worker_index) {
+        TimerPopulation &population = *sweep_population;
+        std::size_t timer_count = population.size();
+        std::size_t chunk_count = (timer_count + partition_alignment - 1) / partition_alignment;
+        std::size_t thread_count = outputs.size();
+        std::size_t begin = std::min(timer_count, chunk_count * worker_index / thread_count * partition_alignment);
+        std::size_t end = std::min(timer_count, chunk_count * (worker_index + 1) / thread_count * partition_alignment);
+        std::size_t partition_size = end - begin;
+
+        WorkerOutput &output = outputs[worker_index];
+        if (output.fired_timer_indices.size() < partition_size) {
+            output.fired_timer_indices.resize(partition_size);
+            output.elapsed_tick_counts.resize(partition_size);
+            output.tick_indices.resize(partition_size);
+        }
+
+        const double now_seconds = sweep_now_seconds;
+        const double *anchor_seconds = population.anchor_seconds.data() + begin;
+        const double *period_seconds = population.period_seconds.data() + begin;
+        float *phases = population.phases.data() + begin;
+        std::int64_t *tick_indices = output.tick_indices.data();
+
+        // pure arithmetic, this is the same timeline math as periodic_timeline, written out so it vectorizes
+        for (std::size_t i = 0; i < partition_size; i++) {
+            double elapsed_cycles = (now_seconds - anchor_seconds[i]) / period_seconds[i];
+            double tick_index = std::floor(elapsed_cycles);
+            phases[i] = static_cast<float>(elapsed_cycles - tick_index);
+            // a tiny period or an anchor far in the past can overflow the cast, which is undefined, so clamp first
+            tick_index = tick_index > min_tick_index ? tick_index : min_tick_index;
+            tick_index = tick_index < max_tick_index ? tick_index : max_tick_index;
+            tick_indices[i] = static_cast<std::int64_t>(tick_index);
+        }
+
+        // branchless compaction, every timer is written to the output but the count only moves past the due ones
+        std::int64_t *last_consumed_ticks = population.last_consumed_ticks.data() + begin;
+        TimerPopulation::TimerIndex *fired_timer_indices = output.fired_timer_indices.data();
+        std::int64_t *elapsed_tick_counts = output.elapsed_tick_counts.data();
+        std::size_t fired_count = 0;
+        for (std::size_t i = 0; i < partition_size; i++) {
+            std::int64_t elapsed_ticks = tick_indices[i] - last_consumed_ticks[i];
+            bool due = elapsed_ticks > 0;
+            fired_timer_indices[fired_count] = static_cast<TimerPopulation::TimerIndex>(begin + i);
+            elapsed_tick_counts[fired_count] = elapsed_ticks;
+            last_consumed_ticks[i] = due ? tick_indices[i] : last_consumed_ticks[i];
+            fired_count += due;
+        }
+        output.fired_count = fired_count;
+    }
+};
+
+#endif // PARALLEL_TIMER_SWEEPER_HPP
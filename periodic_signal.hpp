@@ -4,6 +4,16 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "idle_waker.hpp"
+#include "published_clock.hpp"
 
 /**
  * @brief the operation mode indicates how the delta times are computed in the PeriodicSignal
@@ -23,6 +33,64 @@ enum class DeltaMode {
     measured,
 };
 
+/**
+ * @brief how PeriodicSignal::wait_for_signal waits for the next signal
+ *
+ * busy polling spins on the clock the whole time, it's the most accurate but uses a whole core to do so
+ *
+ * sleeping asks the os to wake us up at the next signal, it uses almost no cpu but how late we wake up depends on the
+ * os's timer slack and scheduler, which can be anywhere from a few microseconds to a few milliseconds
+ *
+ * hybrid sleeps until shortly before the next signal and then busy polls the rest of the way, which gets close to the
+ * accuracy of busy polling while only spinning for a short time every period
+ */
+enum class WaitStrategy {
+    busy_poll,
+    sleep,
+    hybrid,
+};
+
+/**
+ * @brief the timeline math shared by PeriodicSignal and everything else that lays ticks out at start + n * period
+ *
+ * @details tick n starts at start + n * period and the phase is how far into its tick a time point is, in [0,1].
+ * These are pure functions of the start, the period and the time point, so anything that only stores a start can
+ * work out where it is on the timeline whenever it needs to without ever being polled.
+ */
+namespace periodic_timeline {
+
+inline double get_elapsed_cycles(std::chrono::steady_clock::time_point start_time,
+                                 std::chrono::duration<double> period_duration,
+                                 std::chrono::steady_clock::time_point time_point) {
+    return std::chrono::duration<double>(time_point - start_time).count() / period_duration.count();
+}
+
+/**
+ * @brief the index of the tick the time point is in, negative before the start
+ */
+inline long long get_tick_index(std::chrono::steady_clock::time_point start_time,
+                                std::chrono::duration<double> period_duration,
+                                std::chrono::steady_clock::time_point time_point) {
+    // this is the floor function here.
+    return static_cast<long long>(std::floor(get_elapsed_cycles(start_time, period_duration, time_point)));
+}
+
+inline double get_phase(std::chrono::steady_clock::time_point start_time,
+                        std::chrono::duration<double> period_duration,
+                        std::chrono::steady_clock::time_point time_point) {
+    double elapsed_seconds = std::chrono::duration<double>(time_point - start_time).count();
+    double cycle_position = std::fmod(elapsed_seconds, period_duration.count());
+    return std::clamp(cycle_position / period_duration.count(), 0.0, 1.0);
+}
+
+inline std::chrono::steady_clock::time_point get_time_point_at_cycles(std::chrono::steady_clock::time_point start_time,
+                                                                       std::chrono::duration<double> period_duration,
+                                                                       double cycles) {
+    return start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(cycles * period_duration);
+}
+
+} // namespace periodic_timeline
+
 /**
  * @brief A class for generating periodic signals based on a specified rate with different operation modes
  *
@@ -77,10 +145,65 @@ class PeriodicSignal {
      * @note This does not change the signal rate or operation mode.
      */
     void restart() {
-        start_time = std::chrono::steady_clock::now();
+        start_time = get_now();
         signal_count = 0;
         last_signal_time = start_time;
         last_delta_time = 0.0;
+        realign_phase_events(start_time);
+        idle = false;
+        consecutive_empty_tick_count = 0;
+    }
+
+    /**
+     * @brief moves the timeline so that at the given time the signal is in the given tick at the given phase, eg to
+     * line up with another machine's timeline
+     *
+     * @details this is a hard jump. If it lands past the last signaled tick the given tick hasn't been signaled yet
+     * and the next poll signals it right away, so a forward resync doesn't skip the work of the tick it lands in, the
+     * ticks it jumped over are skipped like missed ticks are. If it lands on or before the last signaled tick the given
+     * tick counts as already signaled, so the next signal is the one after it. For small corrections use
+     * @see advance_timeline instead.
+     *
+     * @param phase progress [0,1) through the tick
+     */
+    void set_timeline_position(int tick_index, double phase, std::chrono::steady_clock::time_point time_point) {
+        start_time = time_point - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                      (static_cast<double>(tick_index) + phase) * period_duration);
+        signal_count = tick_index > signal_count ? tick_index - 1 : tick_index;
+
+        // crossings that were due but not reported yet are still reported by the next process_phase_events, only if
+        // the timeline jumped back behind them do the phase events start over from the new position
+        for (PhaseEvent &phase_event : phase_events) {
+            phase_event.added_at_cycles = -std::numeric_limits<double>::infinity();
+        }
+        if (!phase_events.empty() && get_pending_phase_event_cycles() > static_cast<double>(tick_index) + phase) {
+            realign_phase_events(time_point);
+        } else {
+            update_next_phase_event_time();
+        }
+    }
+
+    void set_timeline_position(int tick_index, double phase) { set_timeline_position(tick_index, phase, get_now()); }
+
+    /**
+     * @brief nudges the timeline, a positive amount makes every upcoming tick happen that much sooner and a negative
+     * amount makes them happen later
+     *
+     * @details unlike @see set_timeline_position the ticks that have already been signaled stay signaled, so slewing
+     * back and forth across a tick boundary never makes a tick fire twice or get skipped
+     */
+    void advance_timeline(std::chrono::duration<double> amount) {
+        start_time -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(amount);
+        // the next phase event is tracked by its position on the timeline so it stays where it is, a slew forward
+        // just makes the crossings it stepped over due right away
+        update_next_phase_event_time();
+    }
+
+    /**
+     * @brief where on the timeline the given time is, in ticks, eg 12.25 is a quarter of the way through tick 12
+     */
+    double get_timeline_position_at(std::chrono::steady_clock::time_point time_point) const {
+        return periodic_timeline::get_elapsed_cycles(start_time, period_duration, time_point);
     }
 
     /**
@@ -88,27 +211,198 @@ class PeriodicSignal {
      *        If we have fallen behind, it "catches up" to the latest expected signal.
      * @note this is the function that should be called when you want to do something with the signal
      */
-    bool process_and_get_signal() {
-        auto now = std::chrono::steady_clock::now();
+    bool process_and_get_signal() { return process_and_get_signal_at(get_now()); }
+
+    /**
+     * @brief @see process_and_get_signal with the time already read, @see wait_for_signal passes the real clock here
+     */
+    bool process_and_get_signal_at(std::chrono::steady_clock::time_point now) {
+        if (idle && idle_waker != nullptr && idle_waker->consume_notification()) {
+            wake_from_notification(now);
+        }
 
         // Compute how many full periods have elapsed since start
-        double elapsed_seconds = std::chrono::duration<double>(now - start_time).count();
-        // this is the floor function here.
-        int expected_signal_count = static_cast<int>(elapsed_seconds / period_duration.count());
+        int expected_signal_count = get_tick_index(now);
 
         cycle_progress_at_last_process_and_get_signal_call = get_cycle_progress_at(now);
 
         // If we've reached or passed at least one new signal since last time
-        if (expected_signal_count > signal_count) {
+        int signal_stride = get_signal_stride();
+        bool signal = signal_stride != 0 && expected_signal_count >= signal_count + signal_stride;
+        int missed_signal_count = signal ? expected_signal_count - signal_count - signal_stride : 0;
+        if (signal) {
             // Move signal count to the latest one
             signal_count = expected_signal_count;
             last_delta_time = std::chrono::duration<double>(now - last_signal_time).count();
             last_signal_time = now;
-            return true;
         }
-        return false;
+
+        if (poll_statistics_enabled) {
+            double lateness_seconds =
+                std::chrono::duration<double>(now - get_time_point_at_cycles(expected_signal_count)).count();
+            record_poll(now, signal, missed_signal_count, lateness_seconds);
+        }
+        return signal;
     }
 
+    /**
+     * @brief counters describing how a PeriodicSignal is being polled
+     *
+     * @details the time between two calls to @see process_and_get_signal is attributed to polling if the first call
+     * returned false, and to working if it returned true, because that's when the caller goes off and does the work
+     * for the tick. When the signal is polled in a spin loop the polling time is the cpu time the spinning costs.
+     * Time spent asleep inside of @see wait_for_signal is attributed to neither, it's counted as waiting instead, so
+     * the polling time stays the cpu time that was burned and the working time stays the time spent on ticks.
+     *
+     * every delivered signal also records how late it was, that is how long after the tick's place on the timeline the
+     * poll that noticed it happened, and how many ticks were skipped over because we fell behind.
+     */
+    struct PollStatistics {
+        // bucket 0 holds lateness under 1us, bucket i holds [2^(i-1), 2^i) us, the last bucket holds everything else
+        static constexpr std::size_t lateness_bucket_count = 24;
+
+        std::uint64_t delivered_signal_count = 0;
+        std::uint64_t empty_poll_count = 0;
+        std::uint64_t missed_signal_count = 0;
+        double polling_seconds = 0;
+        double working_seconds = 0;
+        // asleep in wait_for_signal, this doesn't cost any cpu
+        double waiting_seconds = 0;
+        double total_lateness_seconds = 0;
+        std::uint64_t lateness_histogram[lateness_bucket_count] = {};
+
+        /**
+         * @brief the upper bound in seconds of the lateness values that land in the given bucket
+         */
+        static double get_lateness_bucket_upper_bound_seconds(std::size_t bucket_index) {
+            return std::ldexp(1.0, static_cast<int>(bucket_index)) * 1e-6;
+        }
+
+        static std::size_t get_lateness_bucket_index(double lateness_seconds) {
+            double lateness_microseconds = lateness_seconds * 1e6;
+            if (lateness_microseconds < 1.0) {
+                return 0;
+            }
+            auto bucket_index = static_cast<std::size_t>(std::ilogb(lateness_microseconds)) + 1;
+            return std::min(bucket_index, lateness_bucket_count - 1);
+        }
+
+        /**
+         * @brief an upper bound on the given percentile [0,1] of lateness in seconds, to the resolution of the buckets
+         */
+        double get_lateness_percentile_seconds(double percentile) const {
+            std::uint64_t total_count = 0;
+            for (std::uint64_t count : lateness_histogram) {
+                total_count += count;
+            }
+            if (total_count == 0) {
+                return 0;
+            }
+            auto rank = static_cast<std::uint64_t>(std::ceil(std::clamp(percentile, 0.0, 1.0) * total_count));
+            std::uint64_t running_count = 0;
+            for (std::size_t bucket_index = 0; bucket_index < lateness_bucket_count; bucket_index++) {
+                running_count += lateness_histogram[bucket_index];
+                if (running_count >= rank && running_count > 0) {
+                    return get_lateness_bucket_upper_bound_seconds(bucket_index);
+                }
+            }
+            return get_lateness_bucket_upper_bound_seconds(lateness_bucket_count - 1);
+        }
+
+        /**
+         * @brief the wall clock time the statistics cover, polling, working and waiting together
+         */
+        double get_observed_seconds() const { return polling_seconds + working_seconds + waiting_seconds; }
+
+        /**
+         * @brief the rate at which signals were actually delivered over the observed time
+         */
+        double get_achieved_rate_hz() const {
+            double total_seconds = get_observed_seconds();
+            if (total_seconds == 0) {
+                return 0;
+            }
+            return static_cast<double>(delivered_signal_count) / total_seconds;
+        }
+
+        /**
+         * @brief the fraction [0,1] of the observed time that was spent working
+         */
+        double get_utilization() const {
+            double total_seconds = get_observed_seconds();
+            if (total_seconds == 0) {
+                return 0;
+            }
+            return working_seconds / total_seconds;
+        }
+
+        /**
+         * @brief the average number of calls that returned false for every call that returned true
+         */
+        double get_empty_polls_per_signal() const {
+            if (delivered_signal_count == 0) {
+                return 0;
+            }
+            return static_cast<double>(empty_poll_count) / static_cast<double>(delivered_signal_count);
+        }
+
+        /**
+         * @brief the fraction [0,1] of the observed time that was spent polling rather than working or waiting
+         */
+        double get_polling_fraction() const {
+            double total_seconds = get_observed_seconds();
+            if (total_seconds == 0) {
+                return 0;
+            }
+            return polling_seconds / total_seconds;
+        }
+
+        std::string get_summary() const {
+            std::ostringstream summary;
+            summary << "signals delivered: " << delivered_signal_count << ", empty polls: " << empty_poll_count
+                    << " (" << get_empty_polls_per_signal() << " per signal), polling: " << polling_seconds
+                    << "s, working: " << working_seconds << "s, waiting: " << waiting_seconds << "s ("
+                    << get_polling_fraction() * 100.0
+                    << "% of time spent polling), missed signals: " << missed_signal_count
+                    << ", lateness p50: " << get_lateness_percentile_seconds(0.5) * 1e6
+                    << "us, p99: " << get_lateness_percentile_seconds(0.99) * 1e6 << "us";
+            return summary.str();
+        }
+    };
+
+    /**
+     * @brief turns the poll statistics on or off, they are off by default
+     *
+     * @note when they are off the only cost is a single branch in @see process_and_get_signal
+     */
+    void set_poll_statistics_enabled(bool enabled) {
+        poll_statistics_enabled = enabled;
+        has_previous_poll = false;
+        waiting_seconds_since_previous_poll = 0;
+    }
+
+    const PollStatistics &get_poll_statistics() const { return poll_statistics; }
+
+    void reset_poll_statistics() {
+        poll_statistics = PollStatistics();
+        has_previous_poll = false;
+        waiting_seconds_since_previous_poll = 0;
+    }
+
+    /**
+     * @brief the length of one cycle in seconds
+     */
+    double get_period_seconds() const { return period_duration.count(); }
+
+    /**
+     * @brief returns the index of the most recent signal, this only changes when @see process_and_get_signal returns
+     * true or the signal is restarted
+     *
+     * @note things which want to do something once per tick without consuming the signal themselves can remember this
+     * value and check if it changed
+     */
+    int get_signal_count() const { return signal_count; }
+
     /**
      * @brief returns the amount of time it took for the last signal to come through
      *
@@ -123,14 +417,100 @@ class PeriodicSignal {
         return last_delta_time;
     }
 
+    /**
+     * @brief returns the point in time at which the next signal will occur
+     */
+    std::chrono::steady_clock::time_point get_next_signal_time() const {
+        int signal_stride = get_signal_stride();
+        if (signal_stride == 0) {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        return get_time_point_at_cycles(static_cast<double>(signal_count + signal_stride));
+    }
+
+    /**
+     * @brief blocks until the next signal occurs and processes it, as if @see process_and_get_signal had returned true
+     *
+     * @details this always checks the real clock, even if a PublishedClock was set with @see set_time_source. The
+     * published time only moves when somebody publishes it, and if that's the thread which is blocked in here it
+     * would never reach the next signal time.
+     *
+     * @param spin_duration with the hybrid strategy, how long before the signal we stop sleeping and start spinning,
+     * this should cover how late the os usually wakes us up
+     */
+    void wait_for_signal(WaitStrategy wait_strategy = WaitStrategy::hybrid,
+                         std::chrono::steady_clock::duration spin_duration = std::chrono::microseconds(200)) {
+        if (wait_strategy != WaitStrategy::busy_poll || get_signal_stride() == 0) {
+            auto wake_time = get_next_signal_time();
+            if (wait_strategy == WaitStrategy::hybrid && wake_time != std::chrono::steady_clock::time_point::max()) {
+                wake_time -= spin_duration;
+            }
+            sleep_until_or_woken(wake_time);
+        }
+        while (!process_and_get_signal_at(std::chrono::steady_clock::now())) {
+            // sleep_until can wake up early on some platforms, if it did we go back to sleep
+            if (wait_strategy == WaitStrategy::sleep || get_signal_stride() == 0) {
+                sleep_until_or_woken(get_next_signal_time());
+            }
+        }
+    }
+
+    /**
+     * @brief makes the signal read the time from a PublishedClock instead of the real clock, nullptr goes back to the
+     * real clock
+     *
+     * @details the published time is on the same timeline as the real clock, so this can be switched at any time, the
+     * signal just becomes as stale as the published time is. @see wait_for_signal still waits on the real clock, so the
+     * tick thread can be the one that publishes.
+     *
+     * @param published_clock has to outlive the signal
+     */
+    void set_time_source(const PublishedClock *published_clock) { this->published_clock = published_clock; }
+
+    /**
+     * @brief configures how the signal backs off when the caller keeps reporting ticks without any work
+     *
+     * @details once @see report_tick_work has been told about empty_ticks_before_idle empty ticks in a row the signal
+     * goes idle, while idle it only fires on every idle_rate_divisor'th tick of the original timeline, so the phase
+     * never drifts. If idle_rate_divisor is 0 and an IdleWaker is given the signal doesn't fire at all while idle,
+     * and @see wait_for_signal sleeps until another thread calls IdleWaker::notify.
+     *
+     * as soon as work is reported, or the waker is notified, the signal is back at full rate, a notification also
+     * makes the current tick fire right away so that the new work is handled immediately.
+     *
+     * @param empty_ticks_before_idle 0 turns idle mode off, which is the default
+     * @param idle_waker optional, lets other threads wake the signal up, it has to outlive the signal
+     */
+    void set_idle_policy(int empty_ticks_before_idle, int idle_rate_divisor, IdleWaker *idle_waker = nullptr) {
+        this->empty_ticks_before_idle = empty_ticks_before_idle;
+        this->idle_rate_divisor = idle_rate_divisor;
+        this->idle_waker = idle_waker;
+        idle = false;
+        consecutive_empty_tick_count = 0;
+    }
+
+    /**
+     * @brief tells the signal whether the tick that was just handled had anything to do
+     */
+    void report_tick_work(bool had_work) {
+        if (had_work) {
+            idle = false;
+            consecutive_empty_tick_count = 0;
+            return;
+        }
+        consecutive_empty_tick_count++;
+        if (empty_ticks_before_idle > 0 && consecutive_empty_tick_count >= empty_ticks_before_idle) {
+            idle = true;
+        }
+    }
+
+    bool is_idle() const { return idle; }
+
     /**
      * @brief returns true if a signal would have occurred since the last signal.
      */
     bool enough_time_has_passed() const {
-        auto now = std::chrono::steady_clock::now();
-        double elapsed_seconds = std::chrono::duration<double>(now - start_time).count();
-        int expected_signal_count = static_cast<int>(elapsed_seconds / period_duration.count());
-        return expected_signal_count > signal_count;
+        return get_tick_index(get_now()) > signal_count;
     }
 
     /**
@@ -144,12 +524,7 @@ class PeriodicSignal {
      *
      *
      */
-    double get_cycle_progress() const {
-        auto now = std::chrono::steady_clock::now();
-        double elapsed_seconds = std::chrono::duration<double>(now - start_time).count();
-        double cycle_position = std::fmod(elapsed_seconds, period_duration.count());
-        return std::clamp(cycle_position / period_duration.count(), 0.0, 1.0);
-    }
+    double get_cycle_progress() const { return get_cycle_progress_at(get_now()); }
 
     /**
      * @brief Returns normalized progress [0,1] through the cycle at a given time point.
@@ -164,9 +539,7 @@ class PeriodicSignal {
      * @return A double in the range [0,1] representing progress through the cycle.
      */
     double get_cycle_progress_at(std::chrono::steady_clock::time_point time_point) const {
-        double elapsed_seconds = std::chrono::duration<double>(time_point - start_time).count();
-        double cycle_position = std::fmod(elapsed_seconds, period_duration.count());
-        return std::clamp(cycle_position / period_duration.count(), 0.0, 1.0);
+        return periodic_timeline::get_phase(start_time, period_duration, time_point);
     }
 
     /**
@@ -188,18 +561,280 @@ class PeriodicSignal {
      * @see get_cycle_progress() instead.
      */
     double get_cycle_progress_clamped() const {
-        auto now = std::chrono::steady_clock::now();
-        double elapsed_seconds = std::chrono::duration<double>(now - start_time).count();
-        int expected_signal_count = static_cast<int>(elapsed_seconds / period_duration.count());
+        auto now = get_now();
 
-        if (expected_signal_count > signal_count) {
+        if (get_tick_index(now) > signal_count) {
             // We are behind, so we "max out" progress
             return 1.0;
         }
 
         // Otherwise, compute progress normally
-        double cycle_position = std::fmod(elapsed_seconds, period_duration.count());
-        return std::clamp(cycle_position / period_duration.count(), 0.0, 1.0);
+        return get_cycle_progress_at(now);
+    }
+
+    /**
+     * @brief registers an event which should happen at the given phase of every cycle
+     *
+     * @details for example adding phase events at 0.25 and 0.75 lets you do work a quarter of the way and three
+     * quarters of the way through every period. The deadline of the next phase event is precomputed on the same
+     * timeline as the main tick, so @see process_phase_events only has to compare against the clock.
+     *
+     * the new event is first reported for the first crossing after it was added, crossings of the other phase events
+     * which are due but haven't been reported yet are kept.
+     *
+     * @param phase where in the cycle the event occurs, in the range [0,1)
+     *
+     * @return the id of the phase event, this is what gets passed to the callback in @see process_phase_events
+     */
+    std::size_t add_phase_event(double phase) {
+        auto now = get_now();
+        double elapsed_cycles = periodic_timeline::get_elapsed_cycles(start_time, period_duration, now);
+        bool has_pending_crossings = !phase_events.empty() && get_pending_phase_event_cycles() <= elapsed_cycles;
+        double pending_cycles = has_pending_crossings ? get_pending_phase_event_cycles() : 0;
+
+        std::size_t phase_event_id = phase_event_count++;
+        PhaseEvent phase_event{std::clamp(phase, 0.0, std::nextafter(1.0, 0.0)), phase_event_id, elapsed_cycles};
+        auto position = std::upper_bound(phase_events.begin(), phase_events.end(), phase_event,
+                                         [](const PhaseEvent &a, const PhaseEvent &b) { return a.phase < b.phase; });
+        phase_events.insert(position, phase_event);
+
+        if (has_pending_crossings) {
+            resume_phase_events(pending_cycles);
+        } else {
+            realign_phase_events(now);
+        }
+        return phase_event_id;
+    }
+
+    /**
+     * @brief removes all phase events
+     */
+    void clear_phase_events() {
+        phase_events.clear();
+        phase_event_count = 0;
+        realign_phase_events(get_now());
+    }
+
+    /**
+     * @brief calls on_phase_event(phase_event_id) for every phase event that has been crossed since the last call
+     *
+     * @details crossings are never missed because polls were sparse, if a poll lands after several phase events they
+     * are all reported in the order they occurred. If we have fallen behind by more than a full cycle then like the
+     * main tick we catch up, and only the crossings from the most recent period of time are reported.
+     *
+     * @note this is independent of @see process_and_get_signal, you can use either one or both in the same loop
+     *
+     * @return the number of phase events that were reported
+     */
+    template <typename PhaseEventCallback> std::size_t process_phase_events(PhaseEventCallback &&on_phase_event) {
+        if (phase_events.empty()) {
+            return 0;
+        }
+
+        auto now = get_now();
+        if (now < next_phase_event_time) {
+            return 0;
+        }
+
+        double elapsed_cycles = periodic_timeline::get_elapsed_cycles(start_time, period_duration, now);
+        if (get_phase_event_cycles(phase_event_cycle, next_phase_event_index) <= elapsed_cycles - 1.0) {
+            // we are more than a cycle behind, skip every crossing that happened more than one period ago
+            phase_event_cycle = static_cast<long long>(std::floor(elapsed_cycles - 1.0));
+            next_phase_event_index = 0;
+            while (get_phase_event_cycles(phase_event_cycle, next_phase_event_index) <= elapsed_cycles - 1.0) {
+                advance_phase_event();
+            }
+        }
+
+        std::size_t reported_count = 0;
+        while (get_phase_event_cycles(phase_event_cycle, next_phase_event_index) <= elapsed_cycles) {
+            const PhaseEvent &phase_event = phase_events[next_phase_event_index];
+            // crossings from before the event was added don't count
+            if (get_phase_event_cycles(phase_event_cycle, next_phase_event_index) > phase_event.added_at_cycles) {
+                on_phase_event(phase_event.id);
+                reported_count++;
+            }
+            advance_phase_event();
+        }
+
+        update_next_phase_event_time();
+        return reported_count;
+    }
+
+    /**
+     * @brief returns when the next phase event will be reported by @see process_phase_events
+     *
+     * @note if there are no phase events this is the maximum time point
+     */
+    std::chrono::steady_clock::time_point get_next_phase_event_time() const { return next_phase_event_time; }
+
+  private:
+    const PublishedClock *published_clock = nullptr;
+
+    std::chrono::steady_clock::time_point get_now() const {
+        if (published_clock != nullptr) {
+            return published_clock->now();
+        }
+        return std::chrono::steady_clock::now();
+    }
+
+    int empty_ticks_before_idle = 0;
+    int idle_rate_divisor = 1;
+    IdleWaker *idle_waker = nullptr;
+    int consecutive_empty_tick_count = 0;
+    bool idle = false;
+
+    /**
+     * @brief how many ticks of the timeline the next signal is after the last one, 0 means never
+     */
+    int get_signal_stride() const {
+        if (!idle) {
+            return 1;
+        }
+        if (idle_rate_divisor <= 0) {
+            // without a waker nothing could ever wake us up, so just don't throttle
+            return idle_waker != nullptr ? 0 : 1;
+        }
+        return idle_rate_divisor;
+    }
+
+    void wake_from_notification(std::chrono::steady_clock::time_point now) {
+        idle = false;
+        consecutive_empty_tick_count = 0;
+        // let the tick we're currently in fire right away, after that we are back on the original timeline
+        signal_count = std::max(signal_count, get_tick_index(now) - 1);
+    }
+
+    void sleep_until_or_woken(std::chrono::steady_clock::time_point wake_time) {
+        std::chrono::steady_clock::time_point sleep_start_time;
+        if (poll_statistics_enabled) {
+            sleep_start_time = get_now();
+        }
+        if (idle && idle_waker != nullptr) {
+            idle_waker->wait_until(wake_time);
+        } else {
+            std::this_thread::sleep_until(wake_time);
+        }
+        if (poll_statistics_enabled) {
+            waiting_seconds_since_previous_poll += std::chrono::duration<double>(get_now() - sleep_start_time).count();
+        }
+    }
+
+    bool poll_statistics_enabled = false;
+    PollStatistics poll_statistics;
+    bool has_previous_poll = false;
+    bool previous_poll_was_signal = false;
+    std::chrono::steady_clock::time_point previous_poll_time;
+    // time spent asleep in wait_for_signal since the last poll, which is taken out of the gap between the polls
+    double waiting_seconds_since_previous_poll = 0;
+
+    void record_poll(std::chrono::steady_clock::time_point now, bool signal, int missed_signal_count,
+                     double lateness_seconds) {
+        poll_statistics.waiting_seconds += waiting_seconds_since_previous_poll;
+        if (has_previous_poll) {
+            double seconds_since_previous_poll = std::max(
+                0.0,
+                std::chrono::duration<double>(now - previous_poll_time).count() - waiting_seconds_since_previous_poll);
+            if (previous_poll_was_signal) {
+                poll_statistics.working_seconds += seconds_since_previous_poll;
+            } else {
+                poll_statistics.polling_seconds += seconds_since_previous_poll;
+            }
+        }
+        if (signal) {
+            poll_statistics.delivered_signal_count++;
+            poll_statistics.missed_signal_count += static_cast<std::uint64_t>(missed_signal_count);
+            poll_statistics.total_lateness_seconds += lateness_seconds;
+            poll_statistics.lateness_histogram[PollStatistics::get_lateness_bucket_index(lateness_seconds)]++;
+        } else {
+            poll_statistics.empty_poll_count++;
+        }
+        waiting_seconds_since_previous_poll = 0;
+        has_previous_poll = true;
+        previous_poll_was_signal = signal;
+        previous_poll_time = now;
+    }
+
+    struct PhaseEvent {
+        double phase;
+        std::size_t id;
+        // where on the timeline the event was added
+        double added_at_cycles;
+    };
+
+    // sorted by phase
+    std::vector<PhaseEvent> phase_events;
+    std::size_t phase_event_count = 0;
+    // the phase event that will be reported next is phase_events[next_phase_event_index] in cycle phase_event_cycle
+    long long phase_event_cycle = 0;
+    std::size_t next_phase_event_index = 0;
+    std::chrono::steady_clock::time_point next_phase_event_time = std::chrono::steady_clock::time_point::max();
+
+    double get_phase_event_cycles(long long cycle, std::size_t phase_event_index) const {
+        return static_cast<double>(cycle) + phase_events[phase_event_index].phase;
+    }
+
+    std::chrono::steady_clock::time_point get_time_point_at_cycles(double cycles) const {
+        return periodic_timeline::get_time_point_at_cycles(start_time, period_duration, cycles);
+    }
+
+    int get_tick_index(std::chrono::steady_clock::time_point time_point) const {
+        return static_cast<int>(periodic_timeline::get_tick_index(start_time, period_duration, time_point));
+    }
+
+    /**
+     * @brief where on the timeline the next phase event to be reported is
+     *
+     * @note there has to be at least one phase event
+     */
+    double get_pending_phase_event_cycles() const {
+        return get_phase_event_cycles(phase_event_cycle, next_phase_event_index);
+    }
+
+    void update_next_phase_event_time() {
+        if (phase_events.empty()) {
+            next_phase_event_time = std::chrono::steady_clock::time_point::max();
+            return;
+        }
+        next_phase_event_time = get_time_point_at_cycles(get_pending_phase_event_cycles());
+    }
+
+    /**
+     * @brief points the next phase event at the first one which occurs at or after the given position on the timeline
+     */
+    void resume_phase_events(double cycles) {
+        phase_event_cycle = static_cast<long long>(std::floor(cycles));
+        next_phase_event_index = 0;
+        while (get_pending_phase_event_cycles() < cycles) {
+            advance_phase_event();
+        }
+        update_next_phase_event_time();
+    }
+
+    void advance_phase_event() {
+        next_phase_event_index++;
+        if (next_phase_event_index == phase_events.size()) {
+            next_phase_event_index = 0;
+            phase_event_cycle++;
+        }
+    }
+
+    /**
+     * @brief points the next phase event at the first one which occurs strictly after the given time point
+     */
+    void realign_phase_events(std::chrono::steady_clock::time_point time_point) {
+        if (phase_events.empty()) {
+            next_phase_event_time = std::chrono::steady_clock::time_point::max();
+            return;
+        }
+        double elapsed_cycles = periodic_timeline::get_elapsed_cycles(start_time, period_duration, time_point);
+        phase_event_cycle = static_cast<long long>(std::floor(elapsed_cycles));
+        next_phase_event_index = 0;
+        while (get_phase_event_cycles(phase_event_cycle, next_phase_event_index) <= elapsed_cycles) {
+            advance_phase_event();
+        }
+        next_phase_event_time =
+            get_time_point_at_cycles(get_phase_event_cycles(phase_event_cycle, next_phase_event_index));
     }
 
   private:
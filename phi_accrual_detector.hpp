@@ -0,0 +1,231 @@
+#ifndef PHI_ACCRUAL_DETECTOR_HPP
+#define PHI_ACCRUAL_DETECTOR_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief detects failed peers from their heartbeats, by how unlikely the current silence is given the heartbeat
+ * arrival times seen so far
+ *
+ * @details instead of a fixed rule like "3 missed heartbeats" every peer gets a suspicion level phi, which is
+ * -log10 of the probability that a heartbeat would still be on its way after this much silence. The inter-arrival
+ * times are modelled as a normal distribution learned from the last window_size heartbeats, so a peer on a jittery
+ * link has to be silent for longer before it's suspected than one on a clean link. phi = 1 means a 10% chance the
+ * silence is normal, phi = 8 means a 0.000001% chance, suspecting at 8 is a common choice.
+ *
+ * to scale to tens of thousands of peers the state is stored as a struct of arrays, and the mean and variance are
+ * kept as a running sum and sum of squares over a ring buffer of intervals, so a heartbeat is O(1). phi for every peer
+ * is computed in one pass once per tick by @see process, the loop over the peers has no branches that depend on the
+ * data so it can be auto vectorized.
+ *
+ * a new peer's window starts out with two made up intervals around the expected heartbeat interval, so it can be
+ * judged before it has any history, these roll out of the window as real heartbeats come in.
+ *
+ * usage:
+ *
+ *     PhiAccrualDetector detector(signal, std::chrono::milliseconds(100));
+ *     auto peer = detector.add_peer();
+ *     ...
+ *     detector.heartbeat(peer); // whenever a heartbeat from the peer arrives
+ *     ...
+ *     if (detector.process()) {
+ *         for (auto suspected_peer : detector.get_suspected_peers()) { ... }
+ *     }
+ */
+class PhiAccrualDetector {
+  public:
+    using PeerId = std::uint32_t;
+
+    /**
+     * @param heartbeat_interval how often peers send heartbeats, the starting point for every peer's distribution
+     * @param window_size how many recent intervals each peer's distribution is learned from
+     * @param threshold peers whose phi is above this are suspected
+     * @param min_standard_deviation keeps a peer whose heartbeats are almost perfectly regular from being suspected
+     * the moment one is a little late
+     * @param acceptable_pause extra silence which is never suspicious, eg for garbage collection pauses
+     */
+    PhiAccrualDetector(const PeriodicSignal &signal, std::chrono::duration<double> heartbeat_interval,
+                       std::size_t window_size = 64, double threshold = 8.0,
+                       std::chrono::duration<double> min_standard_deviation = std::chrono::milliseconds(10),
+                       std::chrono::duration<double> acceptable_pause = std::chrono::seconds(0))
+        : signal(signal), heartbeat_interval_seconds(heartbeat_interval.count()),
+          window_size(std::max<std::size_t>(2, window_size)), threshold(threshold),
+          min_standard_deviation_seconds(min_standard_deviation.count()),
+          acceptable_pause_seconds(acceptable_pause.count()), epoch(std::chrono::steady_clock::now()),
+          observed_signal_count(signal.get_signal_count()) {}
+
+    /**
+     * @brief starts tracking a peer, the silence is counted from the given time
+     */
+    PeerId add_peer(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        PeerId peer_id;
+        if (!free_peer_ids.empty()) {
+            peer_id = free_peer_ids.back();
+            free_peer_ids.pop_back();
+        } else {
+            peer_id = static_cast<PeerId>(last_arrival_seconds.size());
+            last_arrival_seconds.push_back(0);
+            interval_sums.push_back(0);
+            interval_square_sums.push_back(0);
+            interval_counts.push_back(0);
+            next_interval_indices.push_back(0);
+            phis.push_back(0);
+            active.push_back(0);
+            intervals.resize(intervals.size() + window_size);
+        }
+        reset_peer(peer_id, now);
+        active[peer_id] = 1;
+        return peer_id;
+    }
+
+    void remove_peer(PeerId peer_id) {
+        active[peer_id] = 0;
+        phis[peer_id] = 0;
+        free_peer_ids.push_back(peer_id);
+    }
+
+    /**
+     * @brief forgets everything learned about the peer, eg after it reconnected
+     */
+    void reset_peer(PeerId peer_id, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        last_arrival_seconds[peer_id] = to_seconds(now);
+        interval_sums[peer_id] = 0;
+        interval_square_sums[peer_id] = 0;
+        interval_counts[peer_id] = 0;
+        next_interval_indices[peer_id] = 0;
+        phis[peer_id] = 0;
+
+        double bootstrap_deviation_seconds = heartbeat_interval_seconds / 4;
+        add_interval(peer_id, heartbeat_interval_seconds - bootstrap_deviation_seconds);
+        add_interval(peer_id, heartbeat_interval_seconds + bootstrap_deviation_seconds);
+    }
+
+    /**
+     * @brief records that a heartbeat from the peer arrived
+     */
+    void heartbeat(PeerId peer_id,
+                   std::chrono::steady_clock::time_point arrival_time = std::chrono::steady_clock::now()) {
+        double arrival_seconds = to_seconds(arrival_time);
+        add_interval(peer_id, arrival_seconds - last_arrival_seconds[peer_id]);
+        last_arrival_seconds[peer_id] = arrival_seconds;
+    }
+
+    /**
+     * @brief if the signal has ticked since the last call evaluates every peer, returns true if it did
+     */
+    bool process() {
+        int signal_count = signal.get_signal_count();
+        if (signal_count == observed_signal_count) {
+            return false;
+        }
+        observed_signal_count = signal_count;
+        evaluate(std::chrono::steady_clock::now());
+        return true;
+    }
+
+    /**
+     * @brief computes phi for every peer as of the given time and collects the suspected ones
+     */
+    void evaluate(std::chrono::steady_clock::time_point now) {
+        double now_seconds = to_seconds(now);
+        std::size_t peer_count = phis.size();
+        for (std::size_t i = 0; i < peer_count; i++) {
+            double count = static_cast<double>(interval_counts[i]);
+            double mean = interval_sums[i] / count;
+            double variance = std::max(0.0, interval_square_sums[i] / count - mean * mean);
+            double standard_deviation = std::max(std::sqrt(variance), min_standard_deviation_seconds);
+            double silence_seconds = now_seconds - last_arrival_seconds[i];
+            phis[i] = compute_phi(silence_seconds, mean + acceptable_pause_seconds, standard_deviation);
+        }
+
+        suspected_peer_ids.clear();
+        for (std::size_t i = 0; i < peer_count; i++) {
+            if (active[i] && phis[i] > threshold) {
+                suspected_peer_ids.push_back(static_cast<PeerId>(i));
+            }
+        }
+    }
+
+    /**
+     * @brief the suspicion level of the peer as of the last evaluation
+     */
+    double get_phi(PeerId peer_id) const { return phis[peer_id]; }
+
+    bool is_suspected(PeerId peer_id) const { return active[peer_id] && phis[peer_id] > threshold; }
+
+    /**
+     * @brief the peers whose phi was above the threshold at the last evaluation
+     */
+    const std::vector<PeerId> &get_suspected_peers() const { return suspected_peer_ids; }
+
+    /**
+     * @brief the mean of the peer's recent heartbeat intervals
+     */
+    double get_mean_interval_seconds(PeerId peer_id) const {
+        return interval_sums[peer_id] / static_cast<double>(interval_counts[peer_id]);
+    }
+
+    std::size_t get_peer_count() const { return phis.size() - free_peer_ids.size(); }
+
+  private:
+    const PeriodicSignal &signal;
+    double heartbeat_interval_seconds;
+    std::size_t window_size;
+    double threshold;
+    double min_standard_deviation_seconds;
+    double acceptable_pause_seconds;
+    std::chrono::steady_clock::time_point epoch;
+    int observed_signal_count;
+
+    // one entry per peer, except intervals which has window_size entries per peer
+    std::vector<double> last_arrival_seconds;
+    std::vector<double> interval_sums;
+    std::vector<double> interval_square_sums;
+    std::vector<std::uint32_t> interval_counts;
+    std::vector<std::uint32_t> next_interval_indices;
+    std::vector<double> phis;
+    std::vector<std::uint8_t> active;
+    std::vector<double> intervals;
+
+    std::vector<PeerId> free_peer_ids;
+    std::vector<PeerId> suspected_peer_ids;
+
+    double to_seconds(std::chrono::steady_clock::time_point time_point) const {
+        return std::chrono::duration<double>(time_point - epoch).count();
+    }
+
+    void add_interval(PeerId peer_id, double interval_seconds) {
+        double &slot = intervals[peer_id * window_size + next_interval_indices[peer_id]];
+        if (interval_counts[peer_id] == window_size) {
+            interval_sums[peer_id] -= slot;
+            interval_square_sums[peer_id] -= slot * slot;
+        } else {
+            interval_counts[peer_id]++;
+        }
+        slot = interval_seconds;
+        interval_sums[peer_id] += interval_seconds;
+        interval_square_sums[peer_id] += interval_seconds * interval_seconds;
+        next_interval_indices[peer_id] = static_cast<std::uint32_t>((next_interval_indices[peer_id] + 1) % window_size);
+    }
+
+    /**
+     * @brief -log10 of the probability that a normally distributed interval is longer than the silence, using a
+     * logistic approximation of the normal cdf which is accurate to about 1e-4 and cheap to compute
+     */
+    static double compute_phi(double silence_seconds, double mean, double standard_deviation) {
+        double y = (silence_seconds - mean) / standard_deviation;
+        double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+        // for large y e underflows, so the tail probability is computed from e directly instead of as 1 - cdf
+        double tail_probability = silence_seconds > mean ? e / (1.0 + e) : 1.0 - 1.0 / (1.0 + e);
+        return std::max(0.0, -std::log10(std::max(tail_probability, 1e-300)));
+    }
+};
+
+#endif // PHI_ACCRUAL_DETECTOR_HPP
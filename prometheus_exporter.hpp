@@ -0,0 +1,338 @@
+#ifndef PROMETHEUS_EXPORTER_HPP
+#define PROMETHEUS_EXPORTER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "periodic_signal.hpp"
+#include "stats_segment.hpp"
+
+/**
+ * @brief formats a sample value or bucket bound with the fewest digits that still read back as the same double, eg
+ * 0.000128 instead of 0.00012799999999999999
+ */
+inline std::string format_prometheus_value(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    char buffer[32];
+    for (int precision = 1; precision < 17; precision++) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (std::strtod(buffer, nullptr) == value) {
+            return buffer;
+        }
+    }
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+/**
+ * @brief renders snapshots of signal statistics in the prometheus text exposition format (version 0.0.4)
+ *
+ * @details every signal becomes a set of series labelled with signal="<name>", the lateness histogram is exported as
+ * a prometheus histogram with the same power of two buckets that PeriodicSignal records, and the p50/p99 lateness are
+ * also exported as gauges since that's what most dashboards want to graph. The time between polls is split into
+ * polling, working and waiting (asleep in wait_for_signal) the same way PollStatistics splits it, so only the polling
+ * seconds are cpu burned on the signal itself.
+ */
+inline std::string render_prometheus_text(const std::vector<PublishedSignalStatistics> &snapshots) {
+    using Statistics = PeriodicSignal::PollStatistics;
+
+    auto escape_label = [](const char *value) {
+        std::string escaped;
+        for (const char *c = value; *c != '\0'; c++) {
+            if (*c == '\\' || *c == '"') {
+                escaped += '\\';
+                escaped += *c;
+            } else if (*c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += *c;
+            }
+        }
+        return escaped;
+    };
+
+    std::ostringstream text;
+
+    auto format_value = [](auto value) {
+        if constexpr (std::is_integral_v<decltype(value)>) {
+            return std::to_string(value);
+        } else {
+            return format_prometheus_value(value);
+        }
+    };
+
+    auto write_family = [&](const char *name, const char *type, const char *help, auto get_value) {
+        text << "# HELP " << name << ' ' << help << '\n';
+        text << "# TYPE " << name << ' ' << type << '\n';
+        for (const PublishedSignalStatistics &snapshot : snapshots) {
+            text << name << "{signal=\"" << escape_label(snapshot.name) << "\"} " << format_value(get_value(snapshot))
+                 << '\n';
+        }
+    };
+
+    using Snapshot = const PublishedSignalStatistics &;
+    write_family("periodic_signal_rate_limit_hz", "gauge", "The configured rate of the signal.",
+                 [](Snapshot s) { return s.rate_limit_hz; });
+    write_family("periodic_signal_achieved_rate_hz", "gauge", "The rate at which signals were actually delivered.",
+                 [](Snapshot s) { return s.achieved_rate_hz; });
+    write_family("periodic_signal_utilization_ratio", "gauge", "Fraction of the observed time spent working.",
+                 [](Snapshot s) { return s.utilization; });
+    write_family("periodic_signal_delivered_total", "counter", "Signals delivered.",
+                 [](Snapshot s) { return s.delivered_signal_count; });
+    write_family("periodic_signal_missed_total", "counter", "Ticks skipped over because the loop fell behind.",
+                 [](Snapshot s) { return s.missed_signal_count; });
+    write_family("periodic_signal_empty_polls_total", "counter", "Polls that did not deliver a signal.",
+                 [](Snapshot s) { return s.empty_poll_count; });
+    write_family("periodic_signal_poll_seconds_total", "counter",
+                 "Time between polls that did not deliver a signal, excluding time asleep in wait_for_signal.",
+                 [](Snapshot s) { return s.polling_seconds; });
+    write_family("periodic_signal_work_seconds_total", "counter", "Time spent working after a signal was delivered.",
+                 [](Snapshot s) { return s.working_seconds; });
+    write_family("periodic_signal_wait_seconds_total", "counter",
+                 "Time spent asleep in wait_for_signal, which uses no cpu.",
+                 [](Snapshot s) { return s.waiting_seconds; });
+
+    auto get_percentile = [](Snapshot s, double percentile) {
+        Statistics statistics;
+        for (std::size_t i = 0; i < Statistics::lateness_bucket_count; i++) {
+            statistics.lateness_histogram[i] = s.lateness_histogram[i];
+        }
+        return statistics.get_lateness_percentile_seconds(percentile);
+    };
+    write_family("periodic_signal_lateness_p50_seconds", "gauge", "Median lateness of delivered signals.",
+                 [&](Snapshot s) { return get_percentile(s, 0.5); });
+    write_family("periodic_signal_lateness_p99_seconds", "gauge", "99th percentile lateness of delivered signals.",
+                 [&](Snapshot s) { return get_percentile(s, 0.99); });
+
+    const char *histogram_name = "periodic_signal_lateness_seconds";
+    text << "# HELP " << histogram_name << " How long after its place on the timeline each signal was delivered.\n";
+    text << "# TYPE " << histogram_name << " histogram\n";
+    for (const PublishedSignalStatistics &snapshot : snapshots) {
+        std::string label = escape_label(snapshot.name);
+        std::uint64_t cumulative_count = 0;
+        // the last bucket is open ended so it only shows up as +Inf
+        for (std::size_t i = 0; i + 1 < Statistics::lateness_bucket_count; i++) {
+            cumulative_count += snapshot.lateness_histogram[i];
+            text << histogram_name << "_bucket{signal=\"" << label
+                 << "\",le=\"" << format_prometheus_value(Statistics::get_lateness_bucket_upper_bound_seconds(i))
+                 << "\"} " << cumulative_count << '\n';
+        }
+        cumulative_count += snapshot.lateness_histogram[Statistics::lateness_bucket_count - 1];
+        text << histogram_name << "_bucket{signal=\"" << label << "\",le=\"+Inf\"} " << cumulative_count << '\n';
+        text << histogram_name << "_sum{signal=\"" << label << "\"} "
+             << format_prometheus_value(snapshot.total_lateness_seconds) << '\n';
+        text << histogram_name << "_count{signal=\"" << label << "\"} " << cumulative_count << '\n';
+    }
+
+    return text.str();
+}
+
+/**
+ * @brief exports the signals in a StatsSegment as prometheus metrics, either over http or into a file
+ *
+ * @details the exporter reads from the shared memory segment that the tick thread publishes into, so all of the
+ * rendering and io happens on the exporter's own thread and the tick thread only ever pays for the seqlock write.
+ * This also means the exporter can just as well run in a separate sidecar process.
+ *
+ * the http handler is deliberately tiny, it answers every request on the socket with the current metrics and closes
+ * the connection, which is all prometheus needs, eg: curl http://127.0.0.1:9464/metrics
+ */
+class PrometheusExporter {
+  public:
+    explicit PrometheusExporter(const std::string &segment_name) : segment_name(segment_name) {}
+
+    PrometheusExporter(const PrometheusExporter &) = delete;
+    PrometheusExporter &operator=(const PrometheusExporter &) = delete;
+
+    ~PrometheusExporter() { stop(); }
+
+    /**
+     * @brief reads every signal out of the segment and renders them, returns an empty string if the segment isn't
+     * available
+     */
+    std::string render() const {
+        StatsSegmentReader reader(segment_name);
+        if (!reader.is_open()) {
+            return "";
+        }
+        std::vector<PublishedSignalStatistics> snapshots;
+        std::size_t entry_count = reader.get_entry_count();
+        snapshots.reserve(entry_count);
+        for (std::size_t entry_index = 0; entry_index < entry_count; entry_index++) {
+            PublishedSignalStatistics snapshot;
+            if (reader.read(entry_index, snapshot)) {
+                snapshots.push_back(snapshot);
+            }
+        }
+        return render_prometheus_text(snapshots);
+    }
+
+    /**
+     * @brief starts serving the metrics over http on the given address, returns false if the socket couldn't be set up
+     * or the server is already running
+     *
+     * @note by default we only listen on loopback, pass "0.0.0.0" to be reachable from other hosts
+     */
+    bool start_http_server(std::uint16_t port, const std::string &address = "127.0.0.1") {
+        if (http_thread.joinable()) {
+            return false;
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in listen_address{};
+        listen_address.sin_family = AF_INET;
+        listen_address.sin_port = htons(port);
+        if (inet_pton(AF_INET, address.c_str(), &listen_address.sin_addr) != 1 ||
+            bind(listen_fd, reinterpret_cast<sockaddr *>(&listen_address), sizeof(listen_address)) != 0 ||
+            listen(listen_fd, 16) != 0) {
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+
+        running = true;
+        http_thread = std::thread([this] { serve_http(); });
+        return true;
+    }
+
+    /**
+     * @brief the port the http server is listening on, useful when it was started on port 0
+     */
+    std::uint16_t get_http_port() const {
+        sockaddr_in bound_address{};
+        socklen_t length = sizeof(bound_address);
+        if (listen_fd < 0 || getsockname(listen_fd, reinterpret_cast<sockaddr *>(&bound_address), &length) != 0) {
+            return 0;
+        }
+        return ntohs(bound_address.sin_port);
+    }
+
+    /**
+     * @brief starts rewriting the metrics into the file at the given rate, returns false if the file writer is already
+     * running
+     *
+     * @details the file is written next to its destination and renamed over it, so readers like the node exporter's
+     * textfile collector never see a half written file
+     */
+    bool start_file_writer(const std::string &path, int rate_hz) {
+        if (file_thread.joinable()) {
+            return false;
+        }
+        running = true;
+        file_thread = std::thread([this, path, rate_hz] {
+            PeriodicSignal signal(rate_hz);
+            while (running) {
+                if (signal.process_and_get_signal()) {
+                    write_file(path);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+        return true;
+    }
+
+    /**
+     * @brief stops the http server and the file writer if they are running
+     */
+    void stop() {
+        running = false;
+        if (http_thread.joinable()) {
+            http_thread.join();
+        }
+        if (file_thread.joinable()) {
+            file_thread.join();
+        }
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+
+    /**
+     * @brief renders the metrics into the file once, returns false if it couldn't be written
+     */
+    bool write_file(const std::string &path) const {
+        std::string temporary_path = path + ".tmp";
+        std::FILE *file = std::fopen(temporary_path.c_str(), "w");
+        if (file == nullptr) {
+            return false;
+        }
+        std::string text = render();
+        bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        written = std::fclose(file) == 0 && written;
+        return written && std::rename(temporary_path.c_str(), path.c_str()) == 0;
+    }
+
+  private:
+    std::string segment_name;
+    std::atomic<bool> running{false};
+    int listen_fd = -1;
+    std::thread http_thread;
+    std::thread file_thread;
+
+    void serve_http() {
+        while (running) {
+            // wake up regularly so that stop doesn't have to wait for a connection
+            pollfd listen_poll{listen_fd, POLLIN, 0};
+            if (::poll(&listen_poll, 1, 100) <= 0) {
+                continue;
+            }
+            int client_fd = accept(listen_fd, nullptr, nullptr);
+            if (client_fd < 0) {
+                continue;
+            }
+
+            // we don't care what was asked for, but read the request so the client doesn't see a reset
+            char request[1024];
+            pollfd client_poll{client_fd, POLLIN, 0};
+            if (::poll(&client_poll, 1, 100) > 0) {
+                [[maybe_unused]] auto ignored = recv(client_fd, request, sizeof(request), 0);
+            }
+
+            std::string body = render();
+            std::string response = "HTTP/1.1 200 OK\r\n"
+                                   "Content-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: " +
+                                   std::to_string(body.size()) +
+                                   "\r\n"
+                                   "Connection: close\r\n\r\n" +
+                                   body;
+            std::size_t sent = 0;
+            while (sent < response.size()) {
+                auto result = send(client_fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (result <= 0) {
+                    break;
+                }
+                sent += static_cast<std::size_t>(result);
+            }
+            close(client_fd);
+        }
+    }
+};
+
+#endif // PROMETHEUS_EXPORTER_HPP
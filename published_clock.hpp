@@ -0,0 +1,156 @@
+#ifndef PUBLISHED_CLOCK_HPP
+#define PUBLISHED_CLOCK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @brief one thread reads the clock and publishes the time, every other thread just loads it
+ *
+ * @details code that needs the time thousands of times per tick pays for a clock read (a vdso call, or worse a real
+ * syscall on some virtual machines) every single time. With a published clock the time is read by one thread at a
+ * fixed rate and stored into an atomic that sits alone on its cache line, and @see now is a relaxed load of it.
+ *
+ * the time is published either by the clock's own thread (@see start) or by calling @see publish from a thread that
+ * is running anyway, eg the tick thread. The published time is always on the steady_clock timeline so it can be
+ * mixed freely with real clock reads.
+ *
+ * the price is staleness, a load can return a time that's up to one publish interval old, plus however late the
+ * publisher was. The publisher keeps track of the gaps between its publishes, @see get_staleness_statistics reports
+ * them so you can check the accuracy you actually get, eg publishing at 100kHz from a spinning thread gives about
+ * 10us.
+ *
+ * usage:
+ *
+ *     PublishedClock clock;
+ *     clock.start(std::chrono::microseconds(10));
+ *     PeriodicSignal signal(60);
+ *     signal.set_time_source(&clock);
+ */
+class PublishedClock {
+  public:
+    struct StalenessStatistics {
+        std::uint64_t publish_count = 0;
+        // the longest time between two publishes, a read can be at most this stale
+        double max_gap_seconds = 0;
+        double mean_gap_seconds = 0;
+    };
+
+    PublishedClock() = default;
+    PublishedClock(const PublishedClock &) = delete;
+    PublishedClock &operator=(const PublishedClock &) = delete;
+
+    ~PublishedClock() { stop(); }
+
+    /**
+     * @brief the most recently published time, or a real clock read if nothing has been published yet
+     */
+    std::chrono::steady_clock::time_point now() const {
+        std::int64_t published_ticks = published_time.load(std::memory_order_relaxed);
+        if (published_ticks == 0) {
+            return std::chrono::steady_clock::now();
+        }
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(published_ticks));
+    }
+
+    /**
+     * @brief reads the clock and publishes it, only one thread may publish at a time
+     */
+    void publish() {
+        auto time = std::chrono::steady_clock::now();
+        std::int64_t ticks = time.time_since_epoch().count();
+        std::int64_t previous_ticks = published_time.load(std::memory_order_relaxed);
+        published_time.store(ticks, std::memory_order_relaxed);
+
+        if (previous_ticks != 0) {
+            std::int64_t gap_ticks = ticks - previous_ticks;
+            gap_count.store(gap_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            total_gap_ticks.store(total_gap_ticks.load(std::memory_order_relaxed) + gap_ticks,
+                                  std::memory_order_relaxed);
+            if (gap_ticks > max_gap_ticks.load(std::memory_order_relaxed)) {
+                max_gap_ticks.store(gap_ticks, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief starts a thread which publishes the time every update period
+     *
+     * @param spin if true the thread busy polls between publishes, which is needed for update periods shorter than
+     * the os's sleep granularity, otherwise it sleeps
+     */
+    void start(std::chrono::steady_clock::duration update_period, bool spin = true) {
+        stop();
+        running = true;
+        publisher = std::thread([this, update_period, spin] {
+            auto next_publish_time = std::chrono::steady_clock::now();
+            while (running.load(std::memory_order_relaxed)) {
+                publish();
+                next_publish_time += update_period;
+                auto now = std::chrono::steady_clock::now();
+                if (next_publish_time < now) {
+                    // fell behind, don't try to publish the missed updates in a burst
+                    next_publish_time = now;
+                }
+                if (spin) {
+                    while (std::chrono::steady_clock::now() < next_publish_time) {
+                    }
+                } else {
+                    std::this_thread::sleep_until(next_publish_time);
+                }
+            }
+        });
+    }
+
+    void stop() {
+        running = false;
+        if (publisher.joinable()) {
+            publisher.join();
+        }
+    }
+
+    /**
+     * @brief how stale a published time is right now, this reads the real clock so it's only for monitoring
+     */
+    std::chrono::steady_clock::duration get_current_staleness() const {
+        std::int64_t published_ticks = published_time.load(std::memory_order_relaxed);
+        if (published_ticks == 0) {
+            return std::chrono::steady_clock::duration::zero();
+        }
+        return std::chrono::steady_clock::now().time_since_epoch() -
+               std::chrono::steady_clock::duration(published_ticks);
+    }
+
+    StalenessStatistics get_staleness_statistics() const {
+        StalenessStatistics statistics;
+        statistics.publish_count = gap_count.load(std::memory_order_relaxed);
+        double tick_seconds = std::chrono::duration<double>(std::chrono::steady_clock::duration(1)).count();
+        statistics.max_gap_seconds = static_cast<double>(max_gap_ticks.load(std::memory_order_relaxed)) * tick_seconds;
+        if (statistics.publish_count != 0) {
+            statistics.mean_gap_seconds = static_cast<double>(total_gap_ticks.load(std::memory_order_relaxed)) *
+                                          tick_seconds / static_cast<double>(statistics.publish_count);
+        }
+        return statistics;
+    }
+
+    void reset_staleness_statistics() {
+        gap_count = 0;
+        total_gap_ticks = 0;
+        max_gap_ticks = 0;
+    }
+
+  private:
+    // readers only ever touch this cache line, so the publisher's bookkeeping doesn't bounce it around
+    alignas(64) std::atomic<std::int64_t> published_time{0};
+
+    alignas(64) std::atomic<std::uint64_t> gap_count{0};
+    std::atomic<std::int64_t> total_gap_ticks{0};
+    std::atomic<std::int64_t> max_gap_ticks{0};
+
+    std::atomic<bool> running{false};
+    std::thread publisher;
+};
+
+#endif // PUBLISHED_CLOCK_HPP
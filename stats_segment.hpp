@@ -0,0 +1,312 @@
+#ifndef STATS_SEGMENT_HPP
+#define STATS_SEGMENT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief a snapshot of a PeriodicSignal's statistics in a fixed layout that can live in shared memory
+ */
+struct PublishedSignalStatistics {
+    char name[64];
+    double rate_limit_hz;
+    double achieved_rate_hz;
+    double utilization;
+    double polling_seconds;
+    double working_seconds;
+    double waiting_seconds;
+    std::uint64_t delivered_signal_count;
+    std::uint64_t empty_poll_count;
+    std::uint64_t missed_signal_count;
+    double total_lateness_seconds;
+    std::uint64_t lateness_histogram[PeriodicSignal::PollStatistics::lateness_bucket_count];
+    // how many times this entry has been published, lets readers tell if the writer is still alive
+    std::uint64_t publish_count;
+};
+
+static_assert(std::is_trivially_copyable_v<PublishedSignalStatistics>);
+static_assert(sizeof(PublishedSignalStatistics) % sizeof(std::uint64_t) == 0);
+
+/**
+ * @brief the layout of the shared memory segment, this is shared by the writer and readers
+ *
+ * @details every entry is protected by its own seqlock, the writer makes the sequence odd, writes the payload and then
+ * makes it even again, a reader copies the payload and retries if the sequence was odd or changed while it was
+ * copying. The payload is copied word by word through relaxed atomics so that the racing reads are well defined.
+ *
+ * bump the version whenever the layout of the segment or of PublishedSignalStatistics changes.
+ */
+namespace stats_segment_layout {
+constexpr std::uint32_t magic = 0x50534947; // "PSIG"
+constexpr std::uint32_t version = 3;
+constexpr std::size_t payload_word_count = sizeof(PublishedSignalStatistics) / sizeof(std::uint64_t);
+
+struct alignas(64) Entry {
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint64_t> payload[payload_word_count];
+};
+
+struct alignas(64) Header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t entry_capacity;
+    std::uint32_t entry_size;
+    std::atomic<std::uint32_t> entry_count;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the seqlock needs lock free atomics");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "the seqlock needs lock free atomics");
+
+inline std::size_t get_segment_size(std::size_t entry_capacity) {
+    return sizeof(Header) + entry_capacity * sizeof(Entry);
+}
+
+inline Entry *get_entries(void *segment) {
+    return reinterpret_cast<Entry *>(static_cast<std::uint8_t *>(segment) + sizeof(Header));
+}
+} // namespace stats_segment_layout
+
+/**
+ * @brief publishes the statistics of PeriodicSignals into a named posix shared memory segment
+ *
+ * @details the segment is created once, after that publishing is just a few stores into memory, so it's cheap enough
+ * to do every tick from the tick thread and doesn't involve any syscalls, sockets or serialization. External tools
+ * map the same segment read only with StatsSegmentReader and read it whenever they like without the tick thread
+ * ever noticing.
+ *
+ * @note the statistics come from PeriodicSignal::get_poll_statistics, so enable poll statistics on the signals you
+ * publish
+ */
+class StatsSegment {
+  public:
+    /**
+     * @param name a posix shared memory name, eg "/my_server_periodic_signals"
+     */
+    StatsSegment(const std::string &name, std::size_t entry_capacity) : name(name) {
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            return;
+        }
+        segment_size = stats_segment_layout::get_segment_size(entry_capacity);
+        if (ftruncate(fd, static_cast<off_t>(segment_size)) != 0) {
+            close(fd);
+            return;
+        }
+        void *mapping = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return;
+        }
+        segment = mapping;
+        entry_names.reserve(entry_capacity);
+        publish_counts.reserve(entry_capacity);
+
+        // ftruncate zero fills, so the header only has to be written once everything else is in place
+        auto *header = static_cast<stats_segment_layout::Header *>(segment);
+        header->entry_capacity = static_cast<std::uint32_t>(entry_capacity);
+        header->entry_size = sizeof(stats_segment_layout::Entry);
+        header->version = stats_segment_layout::version;
+        header->entry_count.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = stats_segment_layout::magic;
+    }
+
+    StatsSegment(const StatsSegment &) = delete;
+    StatsSegment &operator=(const StatsSegment &) = delete;
+
+    /**
+     * @brief unmaps the segment and removes its name, readers that still have it mapped keep working
+     */
+    ~StatsSegment() {
+        if (segment != nullptr) {
+            munmap(segment, segment_size);
+            shm_unlink(name.c_str());
+        }
+    }
+
+    /**
+     * @brief false if the segment couldn't be created or mapped, in that case adding and publishing do nothing
+     */
+    bool is_open() const { return segment != nullptr; }
+
+    /**
+     * @brief reserves an entry for a signal, returns the entry index or -1 if the segment is full or isn't open
+     */
+    int add_signal(const std::string &signal_name) {
+        if (!is_open()) {
+            return -1;
+        }
+        auto *header = static_cast<stats_segment_layout::Header *>(segment);
+        std::uint32_t entry_index = header->entry_count.load(std::memory_order_relaxed);
+        if (entry_index >= header->entry_capacity) {
+            return -1;
+        }
+        // the name is truncated to fit and is always null terminated
+        entry_names.push_back(signal_name.substr(0, sizeof(PublishedSignalStatistics::name) - 1));
+        publish_counts.push_back(0);
+        header->entry_count.store(entry_index + 1, std::memory_order_release);
+        return static_cast<int>(entry_index);
+    }
+
+    /**
+     * @brief writes a snapshot of the signal's statistics into the entry, does nothing if the entry index is invalid
+     */
+    void publish(int entry_index, const PeriodicSignal &signal) {
+        if (!is_valid_entry(entry_index)) {
+            return;
+        }
+        const PeriodicSignal::PollStatistics &statistics = signal.get_poll_statistics();
+        PublishedSignalStatistics published = {};
+        std::memcpy(published.name, entry_names[entry_index].c_str(), entry_names[entry_index].size() + 1);
+        published.rate_limit_hz = 1.0 / signal.get_period_seconds();
+        published.achieved_rate_hz = statistics.get_achieved_rate_hz();
+        published.utilization = statistics.get_utilization();
+        published.polling_seconds = statistics.polling_seconds;
+        published.working_seconds = statistics.working_seconds;
+        published.waiting_seconds = statistics.waiting_seconds;
+        published.delivered_signal_count = statistics.delivered_signal_count;
+        published.empty_poll_count = statistics.empty_poll_count;
+        published.missed_signal_count = statistics.missed_signal_count;
+        published.total_lateness_seconds = statistics.total_lateness_seconds;
+        std::memcpy(published.lateness_histogram, statistics.lateness_histogram, sizeof(published.lateness_histogram));
+        published.publish_count = ++publish_counts[entry_index];
+        publish(entry_index, published);
+    }
+
+    /**
+     * @brief writes an arbitrary snapshot into the entry, does nothing if the entry index is invalid
+     */
+    void publish(int entry_index, const PublishedSignalStatistics &published) {
+        if (!is_valid_entry(entry_index)) {
+            return;
+        }
+        stats_segment_layout::Entry &entry = stats_segment_layout::get_entries(segment)[entry_index];
+        std::uint64_t words[stats_segment_layout::payload_word_count];
+        std::memcpy(words, &published, sizeof(words));
+
+        std::uint64_t sequence = entry.sequence.load(std::memory_order_relaxed);
+        entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < stats_segment_layout::payload_word_count; i++) {
+            entry.payload[i].store(words[i], std::memory_order_relaxed);
+        }
+        entry.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+  private:
+    std::string name;
+    void *segment = nullptr;
+    std::size_t segment_size = 0;
+    std::vector<std::string> entry_names;
+    std::vector<std::uint64_t> publish_counts;
+
+    // also false for the -1 add_signal returns, and for every index when the segment isn't open
+    bool is_valid_entry(int entry_index) const {
+        return entry_index >= 0 && static_cast<std::size_t>(entry_index) < entry_names.size();
+    }
+};
+
+/**
+ * @brief maps a StatsSegment read only and reads consistent snapshots out of it
+ */
+class StatsSegmentReader {
+  public:
+    explicit StatsSegmentReader(const std::string &name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return;
+        }
+        struct stat segment_stat;
+        if (fstat(fd, &segment_stat) != 0 ||
+            static_cast<std::size_t>(segment_stat.st_size) < sizeof(stats_segment_layout::Header)) {
+            close(fd);
+            return;
+        }
+        segment_size = static_cast<std::size_t>(segment_stat.st_size);
+        void *mapping = mmap(nullptr, segment_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return;
+        }
+
+        auto *header = static_cast<const stats_segment_layout::Header *>(mapping);
+        bool compatible = header->magic == stats_segment_layout::magic &&
+                          header->version == stats_segment_layout::version &&
+                          header->entry_size == sizeof(stats_segment_layout::Entry) &&
+                          stats_segment_layout::get_segment_size(header->entry_capacity) <= segment_size;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!compatible) {
+            munmap(mapping, segment_size);
+            return;
+        }
+        segment = mapping;
+    }
+
+    StatsSegmentReader(const StatsSegmentReader &) = delete;
+    StatsSegmentReader &operator=(const StatsSegmentReader &) = delete;
+
+    ~StatsSegmentReader() {
+        if (segment != nullptr) {
+            munmap(segment, segment_size);
+        }
+    }
+
+    /**
+     * @brief false if the segment doesn't exist or was written by an incompatible version
+     */
+    bool is_open() const { return segment != nullptr; }
+
+    std::size_t get_entry_count() const {
+        if (!is_open()) {
+            return 0;
+        }
+        auto *header = static_cast<const stats_segment_layout::Header *>(segment);
+        return header->entry_count.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief copies a consistent snapshot of the entry, returns false if the entry doesn't exist or the writer kept it
+     * busy for every attempt
+     */
+    bool read(std::size_t entry_index, PublishedSignalStatistics &published, int max_attempts = 1000) const {
+        if (entry_index >= get_entry_count()) {
+            return false;
+        }
+        const stats_segment_layout::Entry &entry = stats_segment_layout::get_entries(segment)[entry_index];
+        std::uint64_t words[stats_segment_layout::payload_word_count];
+        for (int attempt = 0; attempt < max_attempts; attempt++) {
+            std::uint64_t sequence_before = entry.sequence.load(std::memory_order_acquire);
+            if (sequence_before % 2 == 1) {
+                continue;
+            }
+            for (std::size_t i = 0; i < stats_segment_layout::payload_word_count; i++) {
+                words[i] = entry.payload[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry.sequence.load(std::memory_order_relaxed) == sequence_before) {
+                std::memcpy(&published, words, sizeof(words));
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    void *segment = nullptr;
+    std::size_t segment_size = 0;
+};
+
+#endif // STATS_SEGMENT_HPP
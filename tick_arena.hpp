@@ -0,0 +1,132 @@
+#ifndef TICK_ARENA_HPP
+#define TICK_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief a bump allocator for data that only lives for one tick of a PeriodicSignal
+ *
+ * @details the arena has two buffers, every allocation made during a tick comes out of the current buffer, when the
+ * arena notices that the signal has ticked the buffers are swapped and the new current buffer is reset. This means
+ * that data allocated during the previous tick stays readable for one extra tick, which gives consumers a chance to
+ * read what the producer made last tick while the producer is already filling in the next one.
+ *
+ * the arena never calls process_and_get_signal itself, it just looks at the signal count, so it doesn't steal the
+ * signal from whoever is driving the loop. The check happens on every allocation, you can also call
+ * @see sync_with_signal right after processing the signal if you'd like the swap to happen at a known point.
+ *
+ * deallocation is a no-op, memory is only given back when its buffer is reset. If a tick needs more memory than a
+ * buffer has then the extra allocations go to the upstream resource and are released at the same time the buffer
+ * they belong to is reset, ideally this never happens and you should size the arena so it doesn't.
+ *
+ * @note use it through std::pmr containers, eg std::pmr::vector<Message> messages(&tick_arena);
+ */
+class TickArena : public std::pmr::memory_resource {
+  public:
+    TickArena(const PeriodicSignal &signal, std::size_t bytes_per_tick,
+              std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+        : signal(signal), upstream(upstream), observed_signal_count(signal.get_signal_count()) {
+        for (Buffer &buffer : buffers) {
+            buffer.data = static_cast<std::byte *>(upstream->allocate(bytes_per_tick, alignof(std::max_align_t)));
+            buffer.capacity = bytes_per_tick;
+            buffer.overflow_allocations.reserve(16);
+        }
+    }
+
+    TickArena(const TickArena &) = delete;
+    TickArena &operator=(const TickArena &) = delete;
+
+    ~TickArena() override {
+        for (Buffer &buffer : buffers) {
+            release_overflow_allocations(buffer);
+            upstream->deallocate(buffer.data, buffer.capacity, alignof(std::max_align_t));
+        }
+    }
+
+    /**
+     * @brief swaps the buffers if the signal has ticked since the last time we looked
+     */
+    void sync_with_signal() {
+        int signal_count = signal.get_signal_count();
+        if (signal_count == observed_signal_count) {
+            return;
+        }
+        observed_signal_count = signal_count;
+        current_buffer_index = 1 - current_buffer_index;
+        reset(buffers[current_buffer_index]);
+    }
+
+    /**
+     * @brief the number of bytes handed out from the current buffer during this tick
+     */
+    std::size_t get_bytes_used_this_tick() const { return buffers[current_buffer_index].used; }
+
+    std::size_t get_bytes_per_tick() const { return buffers[current_buffer_index].capacity; }
+
+    /**
+     * @brief the number of allocations that didn't fit and had to go upstream since the arena was created
+     */
+    std::size_t get_overflow_allocation_count() const { return overflow_allocation_count; }
+
+  private:
+    struct OverflowAllocation {
+        void *pointer;
+        std::size_t bytes;
+        std::size_t alignment;
+    };
+
+    struct Buffer {
+        std::byte *data = nullptr;
+        std::size_t capacity = 0;
+        std::size_t used = 0;
+        std::vector<OverflowAllocation> overflow_allocations;
+    };
+
+    const PeriodicSignal &signal;
+    std::pmr::memory_resource *upstream;
+    int observed_signal_count;
+    Buffer buffers[2];
+    int current_buffer_index = 0;
+    std::size_t overflow_allocation_count = 0;
+
+    void reset(Buffer &buffer) {
+        buffer.used = 0;
+        release_overflow_allocations(buffer);
+    }
+
+    void release_overflow_allocations(Buffer &buffer) {
+        for (const OverflowAllocation &allocation : buffer.overflow_allocations) {
+            upstream->deallocate(allocation.pointer, allocation.bytes, allocation.alignment);
+        }
+        buffer.overflow_allocations.clear();
+    }
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        sync_with_signal();
+        Buffer &buffer = buffers[current_buffer_index];
+
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(buffer.data);
+        std::uintptr_t aligned = (base + buffer.used + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+        std::size_t new_used = static_cast<std::size_t>(aligned - base) + bytes;
+        if (new_used <= buffer.capacity) {
+            buffer.used = new_used;
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        void *pointer = upstream->allocate(bytes, alignment);
+        buffer.overflow_allocations.push_back({pointer, bytes, alignment});
+        overflow_allocation_count++;
+        return pointer;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+#endif // TICK_ARENA_HPP
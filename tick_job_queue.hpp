@@ -0,0 +1,219 @@
+#ifndef TICK_JOB_QUEUE_HPP
+#define TICK_JOB_QUEUE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief runs background jobs in the slack between the end of a tick's work and the next tick
+ *
+ * @details a job is a step function which does a small bounded piece of work each time it's called and returns true
+ * once the whole job is done, eg warming one cache entry or compacting one chunk. After the tick's real work is done
+ * you call @see run_until_reserve and jobs get stepped in priority order until the time left before the next signal
+ * drops below the reserve, whatever isn't done carries over to the next tick.
+ *
+ * a step is only started if the job's average step duration still fits before the cutoff, so as long as steps are
+ * about the same size they will never push the loop past its next tick. Jobs with the same priority take turns, the
+ * one that ran least recently goes first.
+ *
+ * per job the time consumed, the number of steps and starvation (how many runs in a row the job was left waiting
+ * because higher priority jobs used up the slack) are recorded. The statistics of finished jobs are kept in a ring of
+ * fixed capacity, once it's full the oldest ones are overwritten.
+ *
+ * @note steps must not add or remove jobs, and jobs are plain functors, a coroutine can be wrapped in one that resumes
+ * it and returns whether it's done
+ */
+class TickJobQueue {
+  public:
+    using JobId = std::uint32_t;
+    // returns true once the job is finished
+    using Step = std::function<bool()>;
+
+    struct JobStatistics {
+        std::string name;
+        int priority = 0;
+        std::uint64_t step_count = 0;
+        double consumed_seconds = 0;
+        // the number of runs in a row that this job didn't get to step in, and the worst that has ever been
+        std::uint64_t starved_run_count = 0;
+        std::uint64_t max_starved_run_count = 0;
+
+        double get_mean_step_seconds() const { return step_count == 0 ? 0 : consumed_seconds / step_count; }
+    };
+
+    /**
+     * @param finished_job_statistics_capacity how many finished jobs' statistics are kept
+     */
+    explicit TickJobQueue(std::size_t finished_job_statistics_capacity = 256)
+        : finished_job_statistics(std::max<std::size_t>(1, finished_job_statistics_capacity)) {}
+
+    /**
+     * @brief adds a job, higher priority jobs are stepped first
+     */
+    JobId add_job(std::string name, int priority, Step step) {
+        JobId job_id = next_job_id++;
+        Job job;
+        job.id = job_id;
+        job.step = std::move(step);
+        job.statistics.name = std::move(name);
+        job.statistics.priority = priority;
+        jobs.push_back(std::move(job));
+        return job_id;
+    }
+
+    /**
+     * @brief removes a job before it has finished, returns false if there is no such job
+     */
+    bool remove_job(JobId job_id) {
+        auto job = find_job(job_id);
+        if (job == jobs.end()) {
+            return false;
+        }
+        jobs.erase(job);
+        return true;
+    }
+
+    bool has_job(JobId job_id) { return find_job(job_id) != jobs.end(); }
+
+    std::size_t size() const { return jobs.size(); }
+
+    bool empty() const { return jobs.empty(); }
+
+    /**
+     * @brief steps jobs until less than the reserve is left before the signal's next tick, returns the number of steps
+     *
+     * @note if the signal is idle and won't tick until it's woken up there is no next tick to measure from, then jobs
+     * get one period worth of slack so that a single call still returns
+     */
+    std::size_t run_until_reserve(const PeriodicSignal &signal, std::chrono::steady_clock::duration reserve) {
+        auto next_signal_time = signal.get_next_signal_time();
+        if (next_signal_time == std::chrono::steady_clock::time_point::max()) {
+            next_signal_time = std::chrono::steady_clock::now() +
+                               std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double>(signal.get_period_seconds()));
+        }
+        return run_until(next_signal_time - reserve);
+    }
+
+    /**
+     * @brief steps jobs until the cutoff, returns the number of steps
+     */
+    std::size_t run_until(std::chrono::steady_clock::time_point cutoff) {
+        run_count++;
+        // ids are unique so this is a total order, which keeps the sort in place and deterministic without the buffer
+        // stable_sort would allocate on every run
+        std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) {
+            if (a.statistics.priority != b.statistics.priority) {
+                return a.statistics.priority > b.statistics.priority;
+            }
+            if (a.last_run != b.last_run) {
+                return a.last_run < b.last_run;
+            }
+            return a.id < b.id;
+        });
+
+        std::size_t step_count = 0;
+        auto now = std::chrono::steady_clock::now();
+        for (Job &job : jobs) {
+            auto mean_step_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(job.statistics.get_mean_step_seconds()));
+            while (!job.finished && now + mean_step_duration < cutoff) {
+                job.finished = job.step();
+                auto step_end = std::chrono::steady_clock::now();
+                job.statistics.consumed_seconds += std::chrono::duration<double>(step_end - now).count();
+                job.statistics.step_count++;
+                job.last_run = run_count;
+                step_count++;
+                now = step_end;
+                mean_step_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(job.statistics.get_mean_step_seconds()));
+            }
+
+            if (job.last_run == run_count) {
+                job.statistics.starved_run_count = 0;
+            } else {
+                job.statistics.starved_run_count++;
+                job.statistics.max_starved_run_count =
+                    std::max(job.statistics.max_starved_run_count, job.statistics.starved_run_count);
+            }
+        }
+
+        for (Job &job : jobs) {
+            if (job.finished) {
+                record_finished_job(std::move(job.statistics));
+            }
+        }
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const Job &job) { return job.finished; }), jobs.end());
+        return step_count;
+    }
+
+    /**
+     * @brief the statistics of a job that hasn't finished yet, or nullptr if there is no such job
+     */
+    const JobStatistics *get_job_statistics(JobId job_id) {
+        auto job = find_job(job_id);
+        return job == jobs.end() ? nullptr : &job->statistics;
+    }
+
+    /**
+     * @brief calls on_statistics(const JobStatistics &) for the most recently finished jobs, oldest first
+     */
+    template <typename OnStatistics> void for_each_finished_job_statistics(OnStatistics &&on_statistics) const {
+        std::size_t capacity = finished_job_statistics.size();
+        std::size_t first = (next_finished_job_index + capacity - finished_job_count) % capacity;
+        for (std::size_t i = 0; i < finished_job_count; i++) {
+            on_statistics(finished_job_statistics[(first + i) % capacity]);
+        }
+    }
+
+    /**
+     * @brief how many finished jobs' statistics were overwritten because the ring was full
+     */
+    std::uint64_t get_dropped_finished_job_count() const { return dropped_finished_job_count; }
+
+    void clear_finished_job_statistics() {
+        finished_job_count = 0;
+        dropped_finished_job_count = 0;
+    }
+
+  private:
+    struct Job {
+        JobId id;
+        Step step;
+        JobStatistics statistics;
+        std::uint64_t last_run = 0;
+        bool finished = false;
+    };
+
+    std::vector<Job> jobs;
+    // a ring, the slot after the newest entry is next_finished_job_index
+    std::vector<JobStatistics> finished_job_statistics;
+    std::size_t next_finished_job_index = 0;
+    std::size_t finished_job_count = 0;
+    std::uint64_t dropped_finished_job_count = 0;
+    JobId next_job_id = 0;
+    std::uint64_t run_count = 0;
+
+    void record_finished_job(JobStatistics statistics) {
+        finished_job_statistics[next_finished_job_index] = std::move(statistics);
+        next_finished_job_index = (next_finished_job_index + 1) % finished_job_statistics.size();
+        if (finished_job_count == finished_job_statistics.size()) {
+            dropped_finished_job_count++;
+        } else {
+            finished_job_count++;
+        }
+    }
+
+    std::vector<Job>::iterator find_job(JobId job_id) {
+        return std::find_if(jobs.begin(), jobs.end(), [job_id](const Job &job) { return job.id == job_id; });
+    }
+};
+
+#endif // TICK_JOB_QUEUE_HPP
@@ -0,0 +1,316 @@
+#ifndef TICK_PERF_COUNTERS_HPP
+#define TICK_PERF_COUNTERS_HPP
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "periodic_signal.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief the hardware and software counters that TickPerfCounters can sample
+ */
+enum class PerfCounter {
+    cycles,
+    instructions,
+    cache_misses,
+    context_switches,
+};
+
+/**
+ * @brief the counter deltas for a single tick
+ *
+ * @details a counter that couldn't be opened is always zero, check TickPerfCounters::is_counter_available
+ *
+ * when the kernel had to multiplex the counters because there weren't enough hardware counters for the group, the
+ * values are scaled up from the part of the tick the group was actually counting, running_fraction says how much
+ * of the tick that was, 1 means the values are exact
+ */
+struct TickPerfSample {
+    std::uint64_t values[4] = {};
+    double wall_seconds = 0;
+    double running_fraction = 0;
+    // false if the counters couldn't be read for this tick, the values are then left over from the last good tick
+    bool valid = false;
+
+    std::uint64_t get(PerfCounter counter) const { return values[static_cast<int>(counter)]; }
+
+    /**
+     * @brief instructions per cycle, low values point at stalls (often cache misses), high values at pure compute
+     */
+    double get_instructions_per_cycle() const {
+        std::uint64_t cycles = get(PerfCounter::cycles);
+        return cycles == 0 ? 0 : static_cast<double>(get(PerfCounter::instructions)) / static_cast<double>(cycles);
+    }
+
+    /**
+     * @brief cache misses per thousand instructions
+     */
+    double get_cache_misses_per_kilo_instruction() const {
+        std::uint64_t instructions = get(PerfCounter::instructions);
+        return instructions == 0 ? 0 : 1000.0 * get(PerfCounter::cache_misses) / static_cast<double>(instructions);
+    }
+};
+
+/**
+ * @brief reads cpu performance counters for the calling thread at every tick of a PeriodicSignal
+ *
+ * @details on linux the counters are opened with perf_event_open as one group, so reading all of them at a tick
+ * boundary is a single read syscall. Each counter that can't be opened (no permission, running in a vm without a
+ * virtual pmu, not linux) is simply left out, and if none of them can be opened the whole thing becomes a no-op, so
+ * it's safe to leave this in production code.
+ *
+ * every tick's deltas are attributed to that tick and added to a log2 histogram per counter, the most recent tick is
+ * also kept around so that a slow tick can be looked at right away, eg a tick with context switches was descheduled,
+ * a tick with low instructions per cycle and many cache misses was memory bound and a tick with high instructions
+ * per cycle was just doing a lot of work.
+ *
+ * if reading the counters fails, or the group wasn't scheduled on the pmu at all during a tick, the tick isn't added to
+ * the histograms and the last tick sample is marked invalid, the tick after a failed read is skipped as well since its
+ * deltas would span more than one tick.
+ *
+ * like TickArena this only looks at the signal's count and never calls process_and_get_signal.
+ *
+ * @note the counters only count the thread that constructed this object
+ */
+class TickPerfCounters {
+  public:
+    static constexpr std::size_t counter_count = 4;
+    // bucket i holds values in [2^(i-1), 2^i), bucket 0 holds zero
+    static constexpr std::size_t histogram_bucket_count = 65;
+
+    explicit TickPerfCounters(const PeriodicSignal &signal)
+        : signal(signal), observed_signal_count(signal.get_signal_count()) {
+        open_counters();
+        has_previous_reading = read_counters(previous_reading);
+        previous_time = std::chrono::steady_clock::now();
+    }
+
+    TickPerfCounters(const TickPerfCounters &) = delete;
+    TickPerfCounters &operator=(const TickPerfCounters &) = delete;
+
+    ~TickPerfCounters() { close_counters(); }
+
+    /**
+     * @brief true if at least one counter could be opened
+     */
+    bool is_available() const { return group_fd >= 0; }
+
+    bool is_counter_available(PerfCounter counter) const { return read_positions[static_cast<int>(counter)] >= 0; }
+
+    /**
+     * @brief if the signal has ticked since the last call, attributes the counter deltas since then to the tick that
+     * just ended, returns true if it did
+     */
+    bool process() {
+        int signal_count = signal.get_signal_count();
+        if (signal_count == observed_signal_count) {
+            return false;
+        }
+        observed_signal_count = signal_count;
+        sample();
+        return true;
+    }
+
+    /**
+     * @brief closes off the current tick right now, normally you'd let @see process call this
+     *
+     * @return false if the tick couldn't be measured, see TickPerfSample::valid
+     */
+    bool sample() {
+        last_tick_sample.valid = false;
+        if (!is_available()) {
+            return false;
+        }
+
+        CounterReading reading;
+        if (!read_counters(reading)) {
+            failed_read_count++;
+            has_previous_reading = false;
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        bool had_previous_reading = has_previous_reading;
+        CounterReading previous = previous_reading;
+        previous_reading = reading;
+        has_previous_reading = true;
+        std::chrono::duration<double> wall_duration = now - previous_time;
+        previous_time = now;
+
+        std::uint64_t enabled_time = reading.time_enabled - previous.time_enabled;
+        std::uint64_t running_time = reading.time_running - previous.time_running;
+        if (!had_previous_reading || running_time == 0) {
+            return false;
+        }
+
+        double scale = static_cast<double>(enabled_time) / static_cast<double>(running_time);
+        for (std::size_t i = 0; i < counter_count; i++) {
+            std::uint64_t delta = reading.values[i] - previous.values[i];
+            last_tick_sample.values[i] =
+                running_time == enabled_time ? delta : static_cast<std::uint64_t>(static_cast<double>(delta) * scale);
+            histograms[i][get_bucket_index(last_tick_sample.values[i])]++;
+        }
+        last_tick_sample.wall_seconds = wall_duration.count();
+        last_tick_sample.running_fraction = 1.0 / scale;
+        last_tick_sample.valid = true;
+        sampled_tick_count++;
+        return true;
+    }
+
+    const TickPerfSample &get_last_tick_sample() const { return last_tick_sample; }
+
+    std::uint64_t get_sampled_tick_count() const { return sampled_tick_count; }
+
+    /**
+     * @brief how many times reading the counters failed
+     */
+    std::uint64_t get_failed_read_count() const { return failed_read_count; }
+
+    /**
+     * @brief the number of ticks whose counter value landed in the given bucket
+     */
+    std::uint64_t get_histogram_count(PerfCounter counter, std::size_t bucket_index) const {
+        return histograms[static_cast<int>(counter)][bucket_index];
+    }
+
+    /**
+     * @brief an upper bound on the given percentile [0,1] of the per tick counter value
+     */
+    double get_percentile(PerfCounter counter, double percentile) const {
+        const std::uint64_t *histogram = histograms[static_cast<int>(counter)];
+        if (sampled_tick_count == 0) {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(std::ceil(percentile * static_cast<double>(sampled_tick_count)));
+        std::uint64_t running_count = 0;
+        for (std::size_t bucket_index = 0; bucket_index < histogram_bucket_count; bucket_index++) {
+            running_count += histogram[bucket_index];
+            if (running_count >= rank && running_count > 0) {
+                return bucket_index == 0 ? 0 : std::ldexp(1.0, static_cast<int>(bucket_index));
+            }
+        }
+        return std::ldexp(1.0, static_cast<int>(histogram_bucket_count - 1));
+    }
+
+    void reset_histograms() {
+        std::memset(histograms, 0, sizeof(histograms));
+        sampled_tick_count = 0;
+    }
+
+  private:
+    struct CounterReading {
+        std::uint64_t values[counter_count] = {};
+        // how long the group has been enabled and how long it was actually on the pmu, in nanoseconds
+        std::uint64_t time_enabled = 0;
+        std::uint64_t time_running = 0;
+    };
+
+    const PeriodicSignal &signal;
+    int observed_signal_count;
+    int group_fd = -1;
+    int counter_fds[counter_count] = {-1, -1, -1, -1};
+    // where each counter's value is in the group read, -1 if the counter isn't open
+    int read_positions[counter_count] = {-1, -1, -1, -1};
+    int open_counter_count = 0;
+    CounterReading previous_reading;
+    bool has_previous_reading = false;
+    std::chrono::steady_clock::time_point previous_time;
+    TickPerfSample last_tick_sample;
+    std::uint64_t histograms[counter_count][histogram_bucket_count] = {};
+    std::uint64_t sampled_tick_count = 0;
+    std::uint64_t failed_read_count = 0;
+
+    static std::size_t get_bucket_index(std::uint64_t value) {
+        std::size_t bucket_index = 0;
+        while (value != 0) {
+            value >>= 1;
+            bucket_index++;
+        }
+        return bucket_index;
+    }
+
+#ifdef __linux__
+    void open_counters() {
+        const std::uint32_t types[counter_count] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                    PERF_TYPE_SOFTWARE};
+        const std::uint64_t configs[counter_count] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES};
+
+        for (std::size_t i = 0; i < counter_count; i++) {
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = types[i];
+            attributes.config = configs[i];
+            attributes.read_format =
+                PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            // context switches happen in the kernel so excluding it would hide them
+            attributes.exclude_kernel = types[i] == PERF_TYPE_HARDWARE ? 1 : 0;
+            attributes.exclude_hv = 1;
+            // the group is created disabled and enabled all at once below
+            attributes.disabled = group_fd < 0 ? 1 : 0;
+
+            long fd = syscall(SYS_perf_event_open, &attributes, 0, -1, group_fd, 0);
+            if (fd < 0) {
+                continue;
+            }
+            counter_fds[i] = static_cast<int>(fd);
+            read_positions[i] = open_counter_count++;
+            if (group_fd < 0) {
+                group_fd = counter_fds[i];
+            }
+        }
+
+        if (group_fd >= 0) {
+            ioctl(group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    void close_counters() {
+        for (int &fd : counter_fds) {
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        group_fd = -1;
+    }
+
+    bool read_counters(CounterReading &reading) const {
+        if (group_fd < 0) {
+            return false;
+        }
+        // the group read format is the number of counters, the time enabled, the time running and then each
+        // counter's value
+        std::uint64_t buffer[3 + counter_count] = {};
+        auto expected_size = static_cast<ssize_t>((3 + open_counter_count) * sizeof(std::uint64_t));
+        if (read(group_fd, buffer, sizeof(buffer)) != expected_size ||
+            buffer[0] != static_cast<std::uint64_t>(open_counter_count)) {
+            return false;
+        }
+        reading.time_enabled = buffer[1];
+        reading.time_running = buffer[2];
+        for (std::size_t i = 0; i < counter_count; i++) {
+            if (read_positions[i] >= 0) {
+                reading.values[i] = buffer[3 + read_positions[i]];
+            }
+        }
+        return true;
+    }
+#else
+    void open_counters() {}
+    void close_counters() {}
+    bool read_counters(CounterReading &) const { return false; }
+#endif
+};
+
+#endif // TICK_PERF_COUNTERS_HPP
@@ -0,0 +1,214 @@
+#ifndef TICK_RECLAIMER_HPP
+#define TICK_RECLAIMER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief quiescent state based reclamation (qsbr) where a thread passing a tick boundary is the quiescent state
+ *
+ * @details every thread that reads shared structures is registered and calls @see quiescent_state whenever its
+ * PeriodicSignal fires, before it starts the tick's work. The rule readers have to follow is that no pointer into a
+ * shared structure is kept from one tick to the next, so at a tick boundary a reader holds nothing.
+ *
+ * writers unlink an old version (eg by swapping an atomic pointer) and hand it to @see retire. The retired object is
+ * tagged with the current epoch and the epoch is advanced. A reader that passes a tick boundary afterwards records the
+ * new epoch, so once every registered reader has recorded an epoch newer than the tag nobody can still be looking
+ * at the object and @see reclaim frees it.
+ *
+ * reads cost nothing at all, not even a refcount, and the only thing a reader does is one store per tick. Reclamation
+ * is batched, call @see reclaim once per tick from the writer or any other thread.
+ *
+ * @note a registered thread that stops ticking holds back all reclamation, unregister threads before they stop
+ */
+class TickReclaimer {
+  public:
+    using ThreadId = std::size_t;
+
+    struct Statistics {
+        std::uint64_t retired_count = 0;
+        std::uint64_t reclaimed_count = 0;
+
+        std::uint64_t get_pending_count() const { return retired_count - reclaimed_count; }
+    };
+
+    explicit TickReclaimer(std::size_t max_thread_count = 64) : thread_slots(max_thread_count) {}
+
+    TickReclaimer(const TickReclaimer &) = delete;
+    TickReclaimer &operator=(const TickReclaimer &) = delete;
+
+    /**
+     * @brief frees everything that's still retired, every reader must be done by now
+     */
+    ~TickReclaimer() {
+        for (RetiredObject &retired_object : retired_objects) {
+            retired_object.deleter(retired_object.pointer);
+        }
+    }
+
+    /**
+     * @brief registers a reader thread, it counts as having just passed a tick boundary
+     *
+     * @return the id to pass to @see quiescent_state, or max_thread_count if every slot is taken
+     */
+    ThreadId register_thread() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (ThreadId thread_id = 0; thread_id < thread_slots.size(); thread_id++) {
+            if (thread_slots[thread_id].observed_epoch.load(std::memory_order_relaxed) == offline_epoch) {
+                thread_slots[thread_id].observed_epoch.store(global_epoch.load());
+                return thread_id;
+            }
+        }
+        return thread_slots.size();
+    }
+
+    /**
+     * @brief gives the thread's slot back, returns false if the id isn't a registered thread, eg the max_thread_count
+     * that a failed @see register_thread returns, or a thread that was already unregistered
+     */
+    bool unregister_thread(ThreadId thread_id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (thread_id >= thread_slots.size() ||
+            thread_slots[thread_id].observed_epoch.load(std::memory_order_relaxed) == offline_epoch) {
+            return false;
+        }
+        thread_slots[thread_id].observed_epoch.store(offline_epoch);
+        return true;
+    }
+
+    /**
+     * @brief called by a reader at every tick boundary, after this it must not use any pointer it read before
+     */
+    void quiescent_state(ThreadId thread_id) {
+        thread_slots[thread_id].observed_epoch.store(global_epoch.load(std::memory_order_acquire),
+                                                     std::memory_order_release);
+    }
+
+    /**
+     * @brief hands over an object which has already been unlinked, it's deleted once no reader can be using it
+     */
+    template <typename T> void retire(T *pointer) {
+        retire(pointer, [](void *object) { delete static_cast<T *>(object); });
+    }
+
+    void retire(void *pointer, void (*deleter)(void *)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired_objects.push_back({pointer, deleter, global_epoch.load()});
+        global_epoch.fetch_add(1);
+        statistics.retired_count++;
+    }
+
+    /**
+     * @brief frees every retired object that every registered reader has moved past, returns how many were freed
+     */
+    std::size_t reclaim() {
+        std::vector<RetiredObject> reclaimable_objects;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::uint64_t oldest_observed_epoch = get_oldest_observed_epoch();
+            // retired objects are in epoch order, so everything reclaimable is at the front
+            auto first_pending = std::find_if(retired_objects.begin(), retired_objects.end(),
+                                              [oldest_observed_epoch](const RetiredObject &retired_object) {
+                                                  return retired_object.epoch >= oldest_observed_epoch;
+                                              });
+            reclaimable_objects.assign(retired_objects.begin(), first_pending);
+            retired_objects.erase(retired_objects.begin(), first_pending);
+            statistics.reclaimed_count += reclaimable_objects.size();
+        }
+
+        // deleters run outside the lock, so they can take their time or even retire more objects
+        for (RetiredObject &retired_object : reclaimable_objects) {
+            retired_object.deleter(retired_object.pointer);
+        }
+        return reclaimable_objects.size();
+    }
+
+    Statistics get_statistics() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statistics;
+    }
+
+  private:
+    static constexpr std::uint64_t offline_epoch = std::numeric_limits<std::uint64_t>::max();
+
+    struct alignas(64) ThreadSlot {
+        std::atomic<std::uint64_t> observed_epoch{offline_epoch};
+    };
+
+    struct RetiredObject {
+        void *pointer;
+        void (*deleter)(void *);
+        std::uint64_t epoch;
+    };
+
+    std::vector<ThreadSlot> thread_slots;
+    alignas(64) std::atomic<std::uint64_t> global_epoch{0};
+
+    mutable std::mutex mutex;
+    std::vector<RetiredObject> retired_objects;
+    Statistics statistics;
+
+    std::uint64_t get_oldest_observed_epoch() const {
+        std::uint64_t oldest_observed_epoch = global_epoch.load();
+        for (const ThreadSlot &thread_slot : thread_slots) {
+            oldest_observed_epoch =
+                std::min(oldest_observed_epoch, thread_slot.observed_epoch.load(std::memory_order_acquire));
+        }
+        return oldest_observed_epoch;
+    }
+};
+
+/**
+ * @brief an rcu style pointer to a shared structure, readers load it lock free and writers publish whole new versions
+ *
+ * usage:
+ *
+ *     TickProtected<WorldState> world_state(reclaimer, std::make_unique<WorldState>());
+ *
+ *     // reader thread, every tick
+ *     reclaimer.quiescent_state(reader_id);
+ *     const WorldState *state = world_state.read();
+ *
+ *     // writer thread
+ *     auto next_state = std::make_unique<WorldState>(*world_state.read());
+ *     next_state->apply(changes);
+ *     world_state.publish(std::move(next_state));
+ *     reclaimer.reclaim();
+ *
+ * @note publishing from more than one thread at a time is fine, each old version is retired exactly once
+ */
+template <typename T> class TickProtected {
+  public:
+    TickProtected(TickReclaimer &reclaimer, std::unique_ptr<T> initial_value)
+        : reclaimer(reclaimer), current(initial_value.release()) {}
+
+    TickProtected(const TickProtected &) = delete;
+    TickProtected &operator=(const TickProtected &) = delete;
+
+    ~TickProtected() { reclaimer.retire(current.load()); }
+
+    /**
+     * @brief the current version, valid until the reading thread's next quiescent state
+     */
+    const T *read() const { return current.load(std::memory_order_acquire); }
+
+    /**
+     * @brief makes the new version visible to readers and retires the old one
+     */
+    void publish(std::unique_ptr<T> value) {
+        T *previous = current.exchange(value.release(), std::memory_order_acq_rel);
+        reclaimer.retire(previous);
+    }
+
+  private:
+    TickReclaimer &reclaimer;
+    std::atomic<T *> current;
+};
+
+#endif // TICK_RECLAIMER_HPP
@@ -0,0 +1,132 @@
+#ifndef TICK_SEND_BATCHER_HPP
+#define TICK_SEND_BATCHER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "datagram_queue.hpp"
+#include "periodic_signal.hpp"
+
+/**
+ * @brief collects outgoing udp datagrams during a tick and sends all of them at the tick boundary
+ *
+ * @details instead of doing one syscall per message as things happen, messages are copied into a preallocated
+ * DatagramQueue and flushed with sendmmsg (and UDP GSO when the kernel supports it on the socket) once per tick of
+ * the PeriodicSignal.
+ *
+ * like TickArena this doesn't consume the signal, call @see process once per iteration of your loop (or right after
+ * process_and_get_signal returns true) and it will flush if the signal has ticked since the last flush.
+ */
+class TickSendBatcher {
+  public:
+    /**
+     * @brief stats about how well the batching is going
+     *
+     * @details flush latency is how long the oldest datagram in a flush was waiting in the queue, the worst it can be
+     * is roughly one period of the signal
+     */
+    struct Statistics {
+        std::uint64_t flush_count = 0;
+        std::uint64_t datagrams_sent = 0;
+        std::uint64_t datagrams_failed = 0;
+        // datagrams which were rejected because the queue was full or they were too large
+        std::uint64_t datagrams_rejected = 0;
+        std::uint64_t syscall_count = 0;
+        std::size_t max_batch_size = 0;
+        double total_flush_latency_seconds = 0;
+        double max_flush_latency_seconds = 0;
+
+        double get_mean_batch_size() const {
+            return flush_count == 0 ? 0 : static_cast<double>(datagrams_sent + datagrams_failed) / flush_count;
+        }
+
+        double get_mean_flush_latency_seconds() const {
+            return flush_count == 0 ? 0 : total_flush_latency_seconds / flush_count;
+        }
+
+        /**
+         * @brief how many datagrams went out per syscall, this is the factor by which the syscall rate was reduced
+         */
+        double get_datagrams_per_syscall() const {
+            return syscall_count == 0 ? 0 : static_cast<double>(datagrams_sent) / syscall_count;
+        }
+    };
+
+    TickSendBatcher(int socket_fd, const PeriodicSignal &signal, std::size_t max_datagrams_per_tick,
+                    std::size_t max_datagram_size = 1472)
+        : socket_fd(socket_fd), signal(signal), queue(max_datagrams_per_tick, max_datagram_size),
+          observed_signal_count(signal.get_signal_count()) {
+        queue.enable_gso_if_supported(socket_fd);
+    }
+
+    /**
+     * @brief queues a datagram to be sent at the next tick boundary, returns false if it was rejected
+     */
+    bool enqueue(const void *data, std::size_t size, const sockaddr *address, socklen_t address_length) {
+        if (!queue.push(data, size, address, address_length)) {
+            statistics.datagrams_rejected++;
+            return false;
+        }
+        if (queue.size() == 1) {
+            oldest_enqueue_time = std::chrono::steady_clock::now();
+        }
+        return true;
+    }
+
+    /**
+     * @brief flushes the queue if the signal has ticked since the last time this was called, returns the number of
+     * datagrams sent
+     */
+    std::size_t process() {
+        int signal_count = signal.get_signal_count();
+        if (signal_count == observed_signal_count) {
+            return 0;
+        }
+        observed_signal_count = signal_count;
+        return flush();
+    }
+
+    /**
+     * @brief sends everything in the queue right now, returns the number of datagrams sent
+     */
+    std::size_t flush() {
+        if (queue.empty()) {
+            return 0;
+        }
+
+        DatagramQueue::SendResult result = queue.send(socket_fd, 0, queue.size());
+        double flush_latency_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - oldest_enqueue_time).count();
+
+        statistics.flush_count++;
+        statistics.datagrams_sent += result.datagrams_sent;
+        statistics.datagrams_failed += result.datagrams_failed;
+        statistics.syscall_count += result.syscall_count;
+        statistics.max_batch_size = std::max(statistics.max_batch_size, queue.size());
+        statistics.total_flush_latency_seconds += flush_latency_seconds;
+        statistics.max_flush_latency_seconds = std::max(statistics.max_flush_latency_seconds, flush_latency_seconds);
+
+        queue.clear();
+        return result.datagrams_sent;
+    }
+
+    std::size_t get_pending_datagram_count() const { return queue.size(); }
+
+    const Statistics &get_statistics() const { return statistics; }
+
+    void reset_statistics() { statistics = Statistics(); }
+
+    void set_gso_enabled(bool enabled) { queue.set_gso_enabled(enabled); }
+
+  private:
+    int socket_fd;
+    const PeriodicSignal &signal;
+    DatagramQueue queue;
+    int observed_signal_count;
+    std::chrono::steady_clock::time_point oldest_enqueue_time;
+    Statistics statistics;
+};
+
+#endif // TICK_SEND_BATCHER_HPP
@@ -0,0 +1,193 @@
+#ifndef TICK_SEND_PACER_HPP
+#define TICK_SEND_PACER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "datagram_queue.hpp"
+#include "periodic_signal.hpp"
+
+/**
+ * @brief spreads the datagrams queued during a tick evenly over the first part of the next tick
+ *
+ * @details flushing everything at the tick boundary like TickSendBatcher does puts the whole tick's traffic on the
+ * wire in one burst, which can overflow small switch buffers. This pacer instead splits the previous tick's datagrams
+ * into small groups and gives each group a deadline inside the current tick, group i of n is due at
+ * tick start + spread_fraction * period * i / n, each group going out in a single sendmmsg.
+ *
+ * there's no extra thread, call @see process as often as your loop can, eg while waiting for the next signal, and it
+ * sends every group whose deadline has passed. @see get_next_send_time says when the next group is due so a loop which
+ * otherwise sleeps can wake up for it.
+ *
+ * datagrams enqueued during tick n are sent during tick n + 1, if some are still unsent when tick n + 2 starts (the
+ * loop didn't call process often enough) they're flushed right away before the new tick's pacing starts.
+ *
+ * usage:
+ *
+ *     TickSendPacer pacer(socket_fd, signal, 256, 0.5);
+ *     while (running) {
+ *         if (signal.process_and_get_signal()) {
+ *             pacer.enqueue(...);
+ *         }
+ *         pacer.process();
+ *     }
+ */
+class TickSendPacer {
+  public:
+    struct Statistics {
+        std::uint64_t group_count = 0;
+        std::uint64_t datagrams_sent = 0;
+        std::uint64_t datagrams_failed = 0;
+        // datagrams which were rejected because the queue was full or they were too large
+        std::uint64_t datagrams_rejected = 0;
+        std::uint64_t syscall_count = 0;
+        // datagrams which had to be flushed all at once because their tick ended before they were sent
+        std::uint64_t datagrams_flushed_late = 0;
+        // how long after its deadline each group actually went out
+        double total_group_lateness_seconds = 0;
+        double max_group_lateness_seconds = 0;
+
+        double get_mean_group_lateness_seconds() const {
+            return group_count == 0 ? 0 : total_group_lateness_seconds / group_count;
+        }
+    };
+
+    /**
+     * @param spread_fraction the fraction of the period the sends are spread across, in (0,1]
+     * @param group_size how many datagrams are sent per sendmmsg at most
+     */
+    TickSendPacer(int socket_fd, const PeriodicSignal &signal, std::size_t max_datagrams_per_tick,
+                  double spread_fraction = 0.5, std::size_t group_size = 8, std::size_t max_datagram_size = 1472)
+        : socket_fd(socket_fd), signal(signal), spread_fraction(std::clamp(spread_fraction, 0.0, 1.0)),
+          group_size(std::max<std::size_t>(1, group_size)), queues{{max_datagrams_per_tick, max_datagram_size},
+                                                                     {max_datagrams_per_tick, max_datagram_size}},
+          observed_signal_count(signal.get_signal_count()) {
+        queues[0].enable_gso_if_supported(socket_fd);
+        queues[1].set_gso_enabled(queues[0].is_gso_enabled());
+    }
+
+    /**
+     * @brief queues a datagram to be sent during the next tick, returns false if it was rejected
+     */
+    bool enqueue(const void *data, std::size_t size, const sockaddr *address, socklen_t address_length) {
+        if (!filling_queue->push(data, size, address, address_length)) {
+            statistics.datagrams_rejected++;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief starts pacing the previous tick's datagrams if the signal has ticked, then sends every group that's due
+     *
+     * @return the number of datagrams sent
+     */
+    std::size_t process(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        std::size_t sent_count = 0;
+
+        int signal_count = signal.get_signal_count();
+        if (signal_count != observed_signal_count) {
+            observed_signal_count = signal_count;
+            sent_count += flush_late_datagrams();
+            start_draining(signal_count, now);
+        }
+
+        while (next_datagram < draining_queue->size() && get_next_send_time() <= now) {
+            sent_count += send_group(now);
+        }
+        return sent_count;
+    }
+
+    /**
+     * @brief when the next group is due, or time_point::max() if there's nothing left to send this tick
+     */
+    std::chrono::steady_clock::time_point get_next_send_time() const {
+        if (next_datagram >= draining_queue->size()) {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        std::size_t group_index = next_datagram / group_size;
+        return drain_start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                      group_spacing * static_cast<double>(group_index));
+    }
+
+    std::size_t get_pending_datagram_count() const {
+        return filling_queue->size() + draining_queue->size() - next_datagram;
+    }
+
+    const Statistics &get_statistics() const { return statistics; }
+
+    void reset_statistics() { statistics = Statistics(); }
+
+    void set_gso_enabled(bool enabled) {
+        queues[0].set_gso_enabled(enabled);
+        queues[1].set_gso_enabled(enabled);
+    }
+
+  private:
+    int socket_fd;
+    const PeriodicSignal &signal;
+    double spread_fraction;
+    std::size_t group_size;
+
+    // enqueue fills one queue while the other is being paced out, they swap at every tick
+    DatagramQueue queues[2];
+    DatagramQueue *filling_queue = &queues[0];
+    DatagramQueue *draining_queue = &queues[1];
+    std::size_t next_datagram = 0;
+    std::chrono::steady_clock::time_point drain_start_time;
+    std::chrono::duration<double> group_spacing{0};
+
+    int observed_signal_count;
+    Statistics statistics;
+
+    std::size_t flush_late_datagrams() {
+        std::size_t late_count = draining_queue->size() - next_datagram;
+        if (late_count == 0) {
+            return 0;
+        }
+        DatagramQueue::SendResult result = draining_queue->send(socket_fd, next_datagram, late_count);
+        record_send_result(result);
+        statistics.datagrams_flushed_late += late_count;
+        next_datagram = draining_queue->size();
+        return result.datagrams_sent;
+    }
+
+    void start_draining(int signal_count, std::chrono::steady_clock::time_point now) {
+        draining_queue->clear();
+        std::swap(filling_queue, draining_queue);
+        next_datagram = 0;
+
+        std::chrono::duration<double> period(signal.get_period_seconds());
+        // pace from where the tick that just fired sits on the timeline, this is right no matter how many ticks the
+        // signal strides over while it's idle, where the next signal time would be too far off or never come
+        double ticks_since_signal = std::max(0.0, signal.get_timeline_position_at(now) - signal_count);
+        drain_start_time =
+            now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * ticks_since_signal);
+        std::size_t group_count = (draining_queue->size() + group_size - 1) / group_size;
+        group_spacing = group_count == 0 ? period * 0 : period * spread_fraction / static_cast<double>(group_count);
+    }
+
+    std::size_t send_group(std::chrono::steady_clock::time_point now) {
+        double lateness_seconds = std::chrono::duration<double>(now - get_next_send_time()).count();
+        std::size_t count = std::min(group_size, draining_queue->size() - next_datagram);
+        DatagramQueue::SendResult result = draining_queue->send(socket_fd, next_datagram, count);
+        next_datagram += count;
+
+        record_send_result(result);
+        statistics.group_count++;
+        statistics.total_group_lateness_seconds += lateness_seconds;
+        statistics.max_group_lateness_seconds = std::max(statistics.max_group_lateness_seconds, lateness_seconds);
+        return result.datagrams_sent;
+    }
+
+    void record_send_result(const DatagramQueue::SendResult &result) {
+        statistics.datagrams_sent += result.datagrams_sent;
+        statistics.datagrams_failed += result.datagrams_failed;
+        statistics.syscall_count += result.syscall_count;
+    }
+};
+
+#endif // TICK_SEND_PACER_HPP
@@ -0,0 +1,278 @@
+#ifndef TICK_SYNC_HPP
+#define TICK_SYNC_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief the steady clock time in nanoseconds, which is how times are carried in the tick sync messages
+ */
+inline std::int64_t to_tick_sync_time(std::chrono::steady_clock::time_point time_point) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count();
+}
+
+/**
+ * @brief what a client sends to the server to measure the offset between them
+ *
+ * @note the messages are plain fixed width fields so any transport can carry them, serializing them (and byte order)
+ * is up to the transport
+ */
+struct TickSyncRequest {
+    std::uint32_t sequence;
+    // the client's steady clock, in nanoseconds
+    std::int64_t client_send_time;
+};
+
+/**
+ * @brief the server's answer to a TickSyncRequest
+ */
+struct TickSyncResponse {
+    std::uint32_t sequence;
+    std::int64_t client_send_time;
+    // the server's steady clock, in nanoseconds
+    std::int64_t server_receive_time;
+    std::int64_t server_send_time;
+    // where the server's signal was on its timeline at server_send_time, in ticks
+    double server_timeline_position;
+};
+
+/**
+ * @brief answers tick sync requests with the server's clock and where its signal is on its timeline
+ */
+class TickSyncServer {
+  public:
+    explicit TickSyncServer(const PeriodicSignal &signal) : signal(signal) {}
+
+    /**
+     * @param receive_time when the request came in, taken as close to the socket as possible
+     */
+    TickSyncResponse respond(const TickSyncRequest &request, std::chrono::steady_clock::time_point receive_time,
+                             std::chrono::steady_clock::time_point send_time = std::chrono::steady_clock::now()) const {
+        return {request.sequence, request.client_send_time, to_tick_sync_time(receive_time),
+                to_tick_sync_time(send_time), signal.get_timeline_position_at(send_time)};
+    }
+
+  private:
+    const PeriodicSignal &signal;
+};
+
+/**
+ * @brief keeps a client's PeriodicSignal running a little ahead of the server's, so that the input for a tick
+ * arrives at the server just before the server simulates that tick
+ *
+ * @details the client periodically sends a request from @see create_request, and hands every response to
+ * @see handle_response. Each round trip gives one sample of the clock offset and the round trip time the same way ntp
+ * does, offset = ((t2 - t1) + (t3 - t4)) / 2 and rtt = (t4 - t1) - (t3 - t2).
+ *
+ * samples with a long round trip are the ones where a packet sat in some queue, and those are also the ones where the
+ * delay is most likely to be lopsided and throw the offset off, so only the quarter of the recent samples with the
+ * shortest round trips are used and the offset is the median of those. The rest count as rejected outliers.
+ *
+ * from the offset and the server's position on its timeline we know where the server's timeline is right now, and the
+ * client aims to be ahead of it by half a round trip (the time its input takes to get there) plus the jitter plus a
+ * target margin. @see synchronize moves the client's signal there, small errors are slewed a little at a time so
+ * nothing visibly jumps, and only errors larger than the resync threshold are fixed with a hard jump.
+ *
+ * @note both sides are assumed to run their signals at the same rate
+ */
+class TickSyncClient {
+  public:
+    enum class Adjustment {
+        // not enough samples yet, or the signal is already where it should be
+        none,
+        slewed,
+        resynced,
+    };
+
+    struct Statistics {
+        std::uint64_t request_count = 0;
+        std::uint64_t response_count = 0;
+        // responses dropped because they came in out of order or twice
+        std::uint64_t stale_response_count = 0;
+        // responses whose round trip was too long for them to be used in the estimate
+        std::uint64_t outlier_count = 0;
+        std::uint64_t slew_count = 0;
+        std::uint64_t resync_count = 0;
+    };
+
+    /**
+     * @param target_margin how far ahead of the server the client aims to be on top of the latency and jitter
+     * @param window_size how many recent samples the estimate is made from
+     * @param resync_threshold_ticks errors larger than this are fixed with a hard jump instead of slewing
+     * @param max_slew_ticks the most the timeline is slewed per call to synchronize
+     */
+    explicit TickSyncClient(std::chrono::duration<double> target_margin = std::chrono::milliseconds(5),
+                            std::size_t window_size = 16, double resync_threshold_ticks = 2.0,
+                            double max_slew_ticks = 0.05)
+        : target_margin_seconds(target_margin.count()), window_size(std::max<std::size_t>(1, window_size)),
+          resync_threshold_ticks(resync_threshold_ticks), max_slew_ticks(max_slew_ticks) {}
+
+    TickSyncRequest create_request(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        statistics.request_count++;
+        return {next_sequence++, to_tick_sync_time(now)};
+    }
+
+    /**
+     * @brief adds the round trip to the estimate, returns false if the response was stale and ignored
+     *
+     * @param receive_time when the response came in, taken as close to the socket as possible
+     */
+    bool handle_response(const TickSyncResponse &response,
+                         std::chrono::steady_clock::time_point receive_time = std::chrono::steady_clock::now()) {
+        if (has_handled_response && static_cast<std::int32_t>(response.sequence - last_handled_sequence) <= 0) {
+            statistics.stale_response_count++;
+            return false;
+        }
+        has_handled_response = true;
+        last_handled_sequence = response.sequence;
+        statistics.response_count++;
+
+        std::int64_t client_receive_time = to_tick_sync_time(receive_time);
+        Sample sample;
+        sample.offset_seconds = to_seconds((response.server_receive_time - response.client_send_time) +
+                                           (response.server_send_time - client_receive_time)) /
+                                2;
+        sample.rtt_seconds = std::max(0.0, to_seconds((client_receive_time - response.client_send_time) -
+                                                      (response.server_send_time - response.server_receive_time)));
+        sample.server_send_time = response.server_send_time;
+        sample.server_timeline_position = response.server_timeline_position;
+
+        if (samples.size() < window_size) {
+            samples.push_back(sample);
+        } else {
+            samples[next_sample_index] = sample;
+        }
+        next_sample_index = (next_sample_index + 1) % window_size;
+        latest_sample = sample;
+        update_estimate();
+        return true;
+    }
+
+    bool is_synchronized() const { return !samples.empty(); }
+
+    /**
+     * @brief the server's clock minus the client's clock
+     */
+    double get_offset_seconds() const { return offset_seconds; }
+
+    double get_rtt_seconds() const { return rtt_seconds; }
+
+    /**
+     * @brief the mean amount by which round trips were longer than the shortest recent one
+     */
+    double get_jitter_seconds() const { return jitter_seconds; }
+
+    /**
+     * @brief how far ahead of the server's timeline the client aims to be
+     */
+    double get_target_lead_seconds() const { return rtt_seconds / 2 + jitter_seconds + target_margin_seconds; }
+
+    /**
+     * @brief where the server's signal is on its timeline at the given client time, in ticks
+     */
+    double get_estimated_server_timeline_position(const PeriodicSignal &signal,
+                                                  std::chrono::steady_clock::time_point now) const {
+        double server_now_seconds = to_seconds(to_tick_sync_time(now)) + offset_seconds;
+        double seconds_since_response = server_now_seconds - to_seconds(latest_sample.server_send_time);
+        return latest_sample.server_timeline_position + seconds_since_response / signal.get_period_seconds();
+    }
+
+    /**
+     * @brief how far the signal is from where it should be, in ticks, positive means it's behind
+     */
+    double get_timeline_error_ticks(const PeriodicSignal &signal, std::chrono::steady_clock::time_point now) const {
+        double target_position = get_estimated_server_timeline_position(signal, now) +
+                                 get_target_lead_seconds() / signal.get_period_seconds();
+        return target_position - signal.get_timeline_position_at(now);
+    }
+
+    /**
+     * @brief moves the signal toward where it should be, call this once per tick or after every response
+     */
+    Adjustment synchronize(PeriodicSignal &signal,
+                           std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        if (!is_synchronized()) {
+            return Adjustment::none;
+        }
+
+        double error_ticks = get_timeline_error_ticks(signal, now);
+        if (std::abs(error_ticks) > resync_threshold_ticks) {
+            double target_position = signal.get_timeline_position_at(now) + error_ticks;
+            double tick_index = std::floor(target_position);
+            signal.set_timeline_position(static_cast<int>(tick_index), target_position - tick_index, now);
+            statistics.resync_count++;
+            return Adjustment::resynced;
+        }
+
+        double slew_ticks = std::clamp(error_ticks, -max_slew_ticks, max_slew_ticks);
+        if (slew_ticks == 0) {
+            return Adjustment::none;
+        }
+        signal.advance_timeline(std::chrono::duration<double>(slew_ticks * signal.get_period_seconds()));
+        statistics.slew_count++;
+        return Adjustment::slewed;
+    }
+
+    const Statistics &get_statistics() const { return statistics; }
+
+  private:
+    struct Sample {
+        double offset_seconds = 0;
+        double rtt_seconds = 0;
+        std::int64_t server_send_time = 0;
+        double server_timeline_position = 0;
+    };
+
+    double target_margin_seconds;
+    std::size_t window_size;
+    double resync_threshold_ticks;
+    double max_slew_ticks;
+
+    std::uint32_t next_sequence = 0;
+    bool has_handled_response = false;
+    std::uint32_t last_handled_sequence = 0;
+
+    std::vector<Sample> samples;
+    std::size_t next_sample_index = 0;
+    Sample latest_sample;
+
+    double offset_seconds = 0;
+    double rtt_seconds = 0;
+    double jitter_seconds = 0;
+    Statistics statistics;
+
+    static double to_seconds(std::int64_t nanoseconds) { return static_cast<double>(nanoseconds) * 1e-9; }
+
+    void update_estimate() {
+        std::vector<Sample> by_rtt = samples;
+        std::sort(by_rtt.begin(), by_rtt.end(),
+                  [](const Sample &a, const Sample &b) { return a.rtt_seconds < b.rtt_seconds; });
+
+        std::size_t used_count = std::max<std::size_t>(1, by_rtt.size() / 4);
+        if (latest_sample.rtt_seconds > by_rtt[used_count - 1].rtt_seconds) {
+            statistics.outlier_count++;
+        }
+
+        std::vector<double> offsets;
+        for (std::size_t i = 0; i < used_count; i++) {
+            offsets.push_back(by_rtt[i].offset_seconds);
+        }
+        std::nth_element(offsets.begin(), offsets.begin() + offsets.size() / 2, offsets.end());
+        offset_seconds = offsets[offsets.size() / 2];
+        rtt_seconds = by_rtt[used_count / 2].rtt_seconds;
+
+        double total_excess_rtt_seconds = 0;
+        for (const Sample &sample : by_rtt) {
+            total_excess_rtt_seconds += sample.rtt_seconds - by_rtt.front().rtt_seconds;
+        }
+        jitter_seconds = total_excess_rtt_seconds / static_cast<double>(by_rtt.size());
+    }
+};
+
+#endif // TICK_SYNC_HPP
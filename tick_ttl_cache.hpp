@@ -0,0 +1,196 @@
+#ifndef TICK_TTL_CACHE_HPP
+#define TICK_TTL_CACHE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "periodic_signal.hpp"
+
+/**
+ * @brief a cache whose entries live for a number of ticks of a PeriodicSignal, expiring in bulk once per tick
+ *
+ * @details the time to live is counted in ticks instead of seconds, so neither inserts nor lookups read the clock.
+ * The current tick is cached by @see process, which you call once per loop iteration, and a lookup only compares
+ * the entry's expiry tick against that.
+ *
+ * the cache keeps its own tick count which advances by however many ticks the signal moved forward, if the signal's
+ * count goes backwards, eg because its timeline was moved with set_timeline_position, the cache's tick just stays
+ * where it is, so entries never come back to life and a sweep is never skipped.
+ *
+ * expired entries are removed through a timing wheel, each entry's key is put into the bucket of its expiry tick and
+ * when a tick is processed its bucket is swept, so expiry costs nothing per lookup and no timer per entry. Entries
+ * whose ttl is longer than the wheel just stay in their bucket until the sweep that matches their expiry tick.
+ *
+ * usage:
+ *
+ *     TickTtlCache<std::string, Session> sessions(signal);
+ *     while (running) {
+ *         if (signal.process_and_get_signal()) {
+ *             sessions.process();
+ *         }
+ *         ...
+ *         sessions.insert_or_assign(token, session, std::chrono::minutes(5));
+ *         if (Session *session = sessions.find(token)) { ... }
+ *     }
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>> class TickTtlCache {
+  public:
+    /**
+     * @param wheel_size the number of expiry buckets, ttls up to this many ticks are swept exactly once
+     */
+    explicit TickTtlCache(const PeriodicSignal &signal, std::size_t wheel_size = 1024)
+        : signal(signal), expiry_buckets(std::max<std::size_t>(1, wheel_size)),
+          observed_signal_count(signal.get_signal_count()) {}
+
+    /**
+     * @brief inserts or replaces an entry which expires ttl_ticks ticks from now
+     */
+    void insert_or_assign(const Key &key, Value value, std::int64_t ttl_ticks) {
+        std::int64_t expiry_tick = current_tick + std::max<std::int64_t>(1, ttl_ticks);
+        auto entry = entries.find(key);
+        if (entry == entries.end()) {
+            entries.emplace(key, Entry{std::move(value), expiry_tick});
+        } else {
+            bool same_bucket = get_bucket_index(entry->second.expiry_tick) == get_bucket_index(expiry_tick);
+            entry->second.value = std::move(value);
+            entry->second.expiry_tick = expiry_tick;
+            if (same_bucket) {
+                // a live entry's key is always in its expiry bucket already, pushing it again would duplicate it
+                return;
+            }
+        }
+        // a replaced entry leaves its key behind in its old bucket, the sweep notices the expiry tick doesn't match
+        get_bucket(expiry_tick).push_back(key);
+    }
+
+    /**
+     * @brief inserts or replaces an entry, the ttl is rounded up to whole ticks of the signal
+     */
+    void insert_or_assign(const Key &key, Value value, std::chrono::duration<double> ttl) {
+        auto ttl_ticks = static_cast<std::int64_t>(std::ceil(ttl.count() / signal.get_period_seconds()));
+        insert_or_assign(key, std::move(value), ttl_ticks);
+    }
+
+    /**
+     * @brief the value for the key, or nullptr if there is none or it has expired
+     */
+    Value *find(const Key &key) {
+        auto entry = entries.find(key);
+        if (entry == entries.end() || entry->second.expiry_tick <= current_tick) {
+            return nullptr;
+        }
+        return &entry->second.value;
+    }
+
+    const Value *find(const Key &key) const { return const_cast<TickTtlCache *>(this)->find(key); }
+
+    bool erase(const Key &key) { return entries.erase(key) != 0; }
+
+    /**
+     * @brief the number of entries, including expired ones that haven't been swept yet
+     */
+    std::size_t size() const { return entries.size(); }
+
+    void clear() {
+        entries.clear();
+        for (std::vector<Key> &bucket : expiry_buckets) {
+            bucket.clear();
+        }
+    }
+
+    /**
+     * @brief advances the cache's tick by however many ticks the signal moved forward and removes every entry that
+     * expired since the last call
+     *
+     * @return the number of entries removed
+     */
+    std::size_t process() {
+        int signal_count = signal.get_signal_count();
+        int elapsed_ticks = signal_count - observed_signal_count;
+        observed_signal_count = signal_count;
+        if (elapsed_ticks <= 0) {
+            return 0;
+        }
+        current_tick += elapsed_ticks;
+
+        // after falling behind by a whole wheel every bucket is swept once, each sweep checks every key against the
+        // current tick so nothing is missed
+        std::int64_t first_tick = std::max(last_swept_tick + 1, current_tick - get_wheel_size() + 1);
+        std::size_t expired_count = 0;
+        for (std::int64_t tick = first_tick; tick <= current_tick; tick++) {
+            expired_count += sweep_bucket(get_bucket(tick), tick);
+        }
+        last_swept_tick = current_tick;
+        statistics.expired_count += expired_count;
+        return expired_count;
+    }
+
+    /**
+     * @brief the cache's own tick count, this starts at 0 and never goes backwards
+     */
+    std::int64_t get_current_tick() const { return current_tick; }
+
+    struct Statistics {
+        std::uint64_t expired_count = 0;
+    };
+
+    const Statistics &get_statistics() const { return statistics; }
+
+  private:
+    struct Entry {
+        Value value;
+        std::int64_t expiry_tick;
+        // the tick of the last sweep that kept this key, so a key that ended up in a bucket twice is only kept once
+        std::int64_t kept_on_sweep_tick = 0;
+    };
+
+    const PeriodicSignal &signal;
+    std::unordered_map<Key, Entry, Hash> entries;
+    std::vector<std::vector<Key>> expiry_buckets;
+    int observed_signal_count;
+    std::int64_t current_tick = 0;
+    std::int64_t last_swept_tick = 0;
+    Statistics statistics;
+
+    std::int64_t get_wheel_size() const { return static_cast<std::int64_t>(expiry_buckets.size()); }
+
+    std::size_t get_bucket_index(std::int64_t tick) const {
+        return static_cast<std::size_t>(((tick % get_wheel_size()) + get_wheel_size()) % get_wheel_size());
+    }
+
+    std::vector<Key> &get_bucket(std::int64_t tick) { return expiry_buckets[get_bucket_index(tick)]; }
+
+    std::size_t sweep_bucket(std::vector<Key> &bucket, std::int64_t tick) {
+        std::size_t expired_count = 0;
+        std::size_t kept_count = 0;
+        for (std::size_t i = 0; i < bucket.size(); i++) {
+            auto entry = entries.find(bucket[i]);
+            if (entry == entries.end()) {
+                continue;
+            }
+            std::int64_t expiry_tick = entry->second.expiry_tick;
+            if (expiry_tick <= current_tick) {
+                entries.erase(entry);
+                expired_count++;
+            } else if (get_bucket_index(expiry_tick) == get_bucket_index(tick) &&
+                       entry->second.kept_on_sweep_tick != tick) {
+                // this key belongs here but expires on a later turn of the wheel, later copies of it are dropped
+                entry->second.kept_on_sweep_tick = tick;
+                if (kept_count != i) {
+                    bucket[kept_count] = std::move(bucket[i]);
+                }
+                kept_count++;
+            }
+        }
+        bucket.erase(bucket.begin() + static_cast<std::ptrdiff_t>(kept_count), bucket.end());
+        return expired_count;
+    }
+};
+
+#endif // TICK_TTL_CACHE_HPP
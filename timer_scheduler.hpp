@@ -0,0 +1,315 @@
+#ifndef TIMER_SCHEDULER_HPP
+#define TIMER_SCHEDULER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief refers to a timer that lives inside of a TimerScheduler
+ *
+ * @details the slot is where the timer lives, and the generation is bumped every time the slot is reused or the timer
+ * is cancelled, so a handle to a timer that has already finished can never accidentally cancel a newer timer which
+ * happens to live in the same slot
+ */
+struct TimerHandle {
+    std::uint32_t slot = invalid_slot;
+    std::uint32_t generation = 0;
+
+    static constexpr std::uint32_t invalid_slot = UINT32_MAX;
+
+    bool is_valid() const { return slot != invalid_slot; }
+};
+
+/**
+ * @brief a single deadline structure which holds both one-shot timers and fixed-rate periodic timers
+ *
+ * @details all timers are ordered in one binary min-heap of deadlines, timers themselves live in a slot array which is
+ * recycled through a free list, so once the scheduler has warmed up (or @see reserve was called) scheduling a timer
+ * doesn't allocate.
+ *
+ * cancellation is O(1): the slot's generation is bumped and the slot is returned to the free list, the stale heap
+ * entry is left where it is and gets skipped when it reaches the top of the heap. If stale entries start to outnumber
+ * live ones the heap is rebuilt so that cancelled timers can't make the heap grow without bound.
+ *
+ * periodic timers use the same timeline approach as PeriodicSignal, their deadlines are laid out as anchor + k *
+ * period, and if we fall behind we catch up to the latest tick instead of firing once for every tick that was missed,
+ * this way error doesn't build up over time.
+ *
+ * @note this class is not thread safe, all scheduling, cancelling and polling has to happen on the same thread.
+ */
+class TimerScheduler {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void(TimerHandle)>;
+
+    TimerScheduler() = default;
+
+    /**
+     * @brief pre-allocates room for the given number of simultaneously live timers
+     */
+    void reserve(std::size_t timer_count) {
+        slots.reserve(timer_count);
+        free_slots.reserve(timer_count);
+        heap.reserve(timer_count);
+        due_entries.reserve(timer_count);
+    }
+
+    /**
+     * @brief schedules a callback to run once at the given deadline
+     */
+    TimerHandle schedule_at(Clock::time_point deadline, Callback callback) {
+        std::uint32_t slot_index = acquire_slot();
+        Slot &slot = slots[slot_index];
+        slot.callback = std::move(callback);
+        slot.deadline = deadline;
+        slot.period = Clock::duration::zero();
+        slot.active = true;
+        push_entry(deadline, slot_index, slot.generation);
+        return {slot_index, slot.generation};
+    }
+
+    /**
+     * @brief schedules a callback to run once after the given delay has elapsed
+     */
+    TimerHandle schedule_after(Clock::duration delay, Callback callback) {
+        return schedule_at(Clock::now() + delay, std::move(callback));
+    }
+
+    /**
+     * @brief schedules a callback to run at a fixed rate, the first call happens one period from now
+     *
+     * @return an invalid handle if the rate isn't positive
+     */
+    TimerHandle schedule_periodic(int rate_hz, Callback callback) {
+        if (rate_hz <= 0) {
+            return {};
+        }
+        auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate_hz));
+        return schedule_periodic(period, std::move(callback));
+    }
+
+    /**
+     * @brief schedules a callback to run every period, the first call happens one period after the anchor
+     *
+     * @param anchor where the timer's timeline starts, now by default
+     *
+     * @return an invalid handle if the period isn't positive, such a timer would fire on every poll
+     */
+    TimerHandle schedule_periodic(Clock::duration period, Callback callback, Clock::time_point anchor = Clock::now()) {
+        if (period <= Clock::duration::zero()) {
+            return {};
+        }
+        std::uint32_t slot_index = acquire_slot();
+        Slot &slot = slots[slot_index];
+        slot.callback = std::move(callback);
+        slot.anchor = anchor;
+        slot.period = period;
+        slot.tick_count = 1;
+        slot.deadline = anchor + period;
+        slot.active = true;
+        push_entry(slot.deadline, slot_index, slot.generation);
+        return {slot_index, slot.generation};
+    }
+
+    /**
+     * @brief cancels the timer, returns false if the handle no longer refers to a live timer
+     *
+     * @note it is safe to cancel any timer (including the one currently firing) from inside of a callback
+     */
+    bool cancel(TimerHandle handle) {
+        if (!is_active(handle)) {
+            return false;
+        }
+        // a timer that was pulled into the current poll's due batch has no entry left in the heap
+        bool has_heap_entry = !slots[handle.slot].in_due_batch;
+        release_slot(handle.slot);
+        if (has_heap_entry) {
+            stale_entry_count++;
+            compact_if_mostly_stale();
+        }
+        return true;
+    }
+
+    /**
+     * @brief returns true if the handle refers to a timer that is still waiting to fire
+     */
+    bool is_active(TimerHandle handle) const {
+        return handle.is_valid() && handle.slot < slots.size() && slots[handle.slot].active &&
+               slots[handle.slot].generation == handle.generation;
+    }
+
+    /**
+     * @brief the number of timers that are currently scheduled
+     */
+    std::size_t size() const { return slots.size() - free_slots.size(); }
+
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief returns the earliest deadline out of all live timers, or nothing if there are none
+     */
+    std::optional<Clock::time_point> get_next_deadline() {
+        discard_stale_top();
+        if (heap.empty()) {
+            return std::nullopt;
+        }
+        return heap.front().deadline;
+    }
+
+    /**
+     * @brief fires every timer whose deadline is at or before now, returns how many callbacks were run
+     *
+     * @details all due timers are pulled off the heap in one batch before any callback is run, so a callback which
+     * schedules a new timer that is already due won't be run until the next poll.
+     */
+    std::size_t poll(Clock::time_point now = Clock::now()) {
+        due_entries.clear();
+        while (!heap.empty() && heap.front().deadline <= now) {
+            std::pop_heap(heap.begin(), heap.end(), later_deadline);
+            HeapEntry entry = heap.back();
+            heap.pop_back();
+            if (is_live(entry)) {
+                slots[entry.slot].in_due_batch = true;
+                due_entries.push_back(entry);
+            } else {
+                stale_entry_count--;
+            }
+        }
+
+        std::size_t fired_count = 0;
+        for (const HeapEntry &entry : due_entries) {
+            // an earlier callback in this batch may have cancelled this one
+            if (!is_live(entry)) {
+                continue;
+            }
+            slots[entry.slot].in_due_batch = false;
+            TimerHandle handle{entry.slot, entry.generation};
+            fire(handle, now);
+            fired_count++;
+        }
+        return fired_count;
+    }
+
+    /**
+     * @brief sleeps until the next deadline and then polls, returns how many callbacks were run
+     *
+     * @note if there are no timers this returns immediately
+     */
+    std::size_t wait_and_poll() {
+        auto next_deadline = get_next_deadline();
+        if (!next_deadline) {
+            return 0;
+        }
+        std::this_thread::sleep_until(*next_deadline);
+        return poll();
+    }
+
+  private:
+    struct Slot {
+        Callback callback;
+        Clock::time_point deadline;
+        Clock::time_point anchor;
+        // zero for one-shot timers
+        Clock::duration period = Clock::duration::zero();
+        std::int64_t tick_count = 0;
+        std::uint32_t generation = 0;
+        bool active = false;
+        // popped off the heap by poll but not fired yet
+        bool in_due_batch = false;
+    };
+
+    struct HeapEntry {
+        Clock::time_point deadline;
+        std::uint32_t slot;
+        std::uint32_t generation;
+    };
+
+    static bool later_deadline(const HeapEntry &a, const HeapEntry &b) { return a.deadline > b.deadline; }
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> free_slots;
+    std::vector<HeapEntry> heap;
+    std::vector<HeapEntry> due_entries;
+    std::size_t stale_entry_count = 0;
+
+    bool is_live(const HeapEntry &entry) const {
+        const Slot &slot = slots[entry.slot];
+        return slot.active && slot.generation == entry.generation;
+    }
+
+    std::uint32_t acquire_slot() {
+        if (!free_slots.empty()) {
+            std::uint32_t slot_index = free_slots.back();
+            free_slots.pop_back();
+            return slot_index;
+        }
+        slots.emplace_back();
+        return static_cast<std::uint32_t>(slots.size() - 1);
+    }
+
+    void release_slot(std::uint32_t slot_index) {
+        Slot &slot = slots[slot_index];
+        slot.active = false;
+        slot.in_due_batch = false;
+        slot.generation++;
+        slot.callback = nullptr;
+        free_slots.push_back(slot_index);
+    }
+
+    void push_entry(Clock::time_point deadline, std::uint32_t slot_index, std::uint32_t generation) {
+        heap.push_back({deadline, slot_index, generation});
+        std::push_heap(heap.begin(), heap.end(), later_deadline);
+    }
+
+    void fire(TimerHandle handle, Clock::time_point now) {
+        Slot &slot = slots[handle.slot];
+        bool periodic = slot.period != Clock::duration::zero();
+
+        if (!periodic) {
+            // move the callback out first so that the slot can be reused from inside the callback
+            Callback callback = std::move(slot.callback);
+            release_slot(handle.slot);
+            callback(handle);
+            return;
+        }
+
+        // re-arm before running the callback, catching up to the latest tick if we fell behind
+        std::int64_t expected_tick_count = (now - slot.anchor) / slot.period;
+        slot.tick_count = std::max(slot.tick_count, expected_tick_count) + 1;
+        slot.deadline = slot.anchor + slot.tick_count * slot.period;
+        push_entry(slot.deadline, handle.slot, handle.generation);
+
+        // the callback may schedule new timers which can reallocate the slot array, so don't hold a reference across
+        // the call, and only hand the callback back if the timer wasn't cancelled while it was running
+        Callback callback = std::move(slot.callback);
+        callback(handle);
+        if (is_active(handle)) {
+            slots[handle.slot].callback = std::move(callback);
+        }
+    }
+
+    void discard_stale_top() {
+        while (!heap.empty() && !is_live(heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), later_deadline);
+            heap.pop_back();
+            stale_entry_count--;
+        }
+    }
+
+    void compact_if_mostly_stale() {
+        if (stale_entry_count < 64 || stale_entry_count * 2 < heap.size()) {
+            return;
+        }
+        heap.erase(std::remove_if(heap.begin(), heap.end(), [this](const HeapEntry &entry) { return !is_live(entry); }),
+                   heap.end());
+        std::make_heap(heap.begin(), heap.end(), later_deadline);
+        stale_entry_count = 0;
+    }
+};
+
+#endif // TIMER_SCHEDULER_HPP
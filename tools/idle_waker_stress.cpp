@@ -0,0 +1,126 @@
+/**
+ * @brief idle_waker_stress hammers an IdleWaker from two threads and checks that no wakeup is lost
+ *
+ * @details one thread publishes a sequence number and calls notify, the other waits on the waker's eventfd with poll
+ * the way an epoll based event loop would, calls consume_notification whenever the fd is readable and then reads the
+ * sequence number. It fails if
+ *  - the fd stays quiet for longer than the timeout while there is an unseen sequence number (a lost wakeup)
+ *  - the fd was readable but there was no notification to consume, which would make an epoll loop spin
+ *
+ * the notifier yields every so often so that both sides of the race (notifying while the consumer is draining, and
+ * the consumer draining while a notify is half done) get hit.
+ *
+ * build: g++ -std=c++17 -O2 -I.. idle_waker_stress.cpp -o idle_waker_stress -pthread
+ *
+ * usage: idle_waker_stress [--notifications N] [--timeout-ms MS]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "idle_waker.hpp"
+
+#ifdef __linux__
+
+#include <poll.h>
+
+namespace {
+
+struct Options {
+    std::uint64_t notification_count = 2000000;
+    int timeout_milliseconds = 1000;
+};
+
+Options parse_options(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--notifications") == 0 && i + 1 < argc) {
+            options.notification_count = std::max(1LL, std::atoll(argv[++i]));
+        } else if (std::strcmp(argv[i], "--timeout-ms") == 0 && i + 1 < argc) {
+            options.timeout_milliseconds = std::max(1, std::atoi(argv[++i]));
+        } else {
+            std::fprintf(stderr, "usage: %s [--notifications N] [--timeout-ms MS]\n", argv[0]);
+            std::exit(1);
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options = parse_options(argc, argv);
+
+    IdleWaker waker;
+    std::atomic<std::uint64_t> published_sequence{0};
+
+    std::thread notifier([&] {
+        for (std::uint64_t sequence = 1; sequence <= options.notification_count; sequence++) {
+            published_sequence.store(sequence);
+            waker.notify();
+            if (sequence % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::uint64_t seen_sequence = 0;
+    std::uint64_t wakeup_count = 0;
+    std::uint64_t spurious_wakeup_count = 0;
+    bool lost_wakeup = false;
+    while (seen_sequence < options.notification_count) {
+        pollfd event_poll{waker.get_fd(), POLLIN, 0};
+        int result = ::poll(&event_poll, 1, options.timeout_milliseconds);
+        if (result < 0) {
+            continue;
+        }
+        if (result == 0) {
+            if (published_sequence.load() > seen_sequence) {
+                lost_wakeup = true;
+                break;
+            }
+            continue;
+        }
+        if (!waker.consume_notification()) {
+            spurious_wakeup_count++;
+            // without this an fd that stays readable would spin until the notifier is done
+            if (spurious_wakeup_count > options.notification_count) {
+                break;
+            }
+            continue;
+        }
+        wakeup_count++;
+        seen_sequence = published_sequence.load();
+    }
+
+    if (lost_wakeup || spurious_wakeup_count > options.notification_count) {
+        // let the notifier finish so it can be joined
+        while (published_sequence.load() < options.notification_count) {
+            waker.consume_notification();
+        }
+    }
+    notifier.join();
+
+    bool passed = !lost_wakeup && spurious_wakeup_count == 0;
+    std::printf("{\"notifications\": %llu, \"wakeups\": %llu, \"spurious_wakeups\": %llu, \"lost_wakeup\": %s, "
+                "\"seen_sequence\": %llu, \"passed\": %s}\n",
+                static_cast<unsigned long long>(options.notification_count),
+                static_cast<unsigned long long>(wakeup_count),
+                static_cast<unsigned long long>(spurious_wakeup_count), lost_wakeup ? "true" : "false",
+                static_cast<unsigned long long>(seen_sequence), passed ? "true" : "false");
+    return passed ? 0 : 1;
+}
+
+#else
+
+int main() {
+    std::printf("{\"passed\": true, \"skipped\": \"the eventfd is linux only\"}\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,359 @@
+/**
+ * @brief periodic_signal_probe measures the timing characteristics of the host it runs on and recommends how to
+ * configure PeriodicSignals there
+ *
+ * @details it measures
+ *  - how long it takes to read each clock source
+ *  - how much sleeps overshoot for a few different requested durations
+ *  - whether the tsc is invariant, and what the timer slack is
+ *  - how accurately a PeriodicSignal ticks with each WaitStrategy, on the current cpu or on every cpu
+ *
+ * the report is printed as json to stdout, ending with a recommended clock source, wait strategy and hybrid spin
+ * duration, so it can be run on every host type and the result used to pick a configuration automatically.
+ *
+ * build: g++ -std=c++17 -O2 -I.. periodic_signal_probe.cpp -o periodic_signal_probe -pthread
+ *
+ * usage: periodic_signal_probe [--rate HZ] [--ticks N] [--all-cpus]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/prctl.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "periodic_signal.hpp"
+
+namespace {
+
+struct Options {
+    int rate_hz = 1000;
+    int tick_count = 500;
+    bool all_cpus = false;
+};
+
+struct Distribution {
+    double p50 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+Distribution get_distribution(std::vector<double> values) {
+    Distribution distribution;
+    if (values.empty()) {
+        return distribution;
+    }
+    std::sort(values.begin(), values.end());
+    auto at = [&](double percentile) {
+        auto index = static_cast<std::size_t>(percentile * static_cast<double>(values.size() - 1));
+        return values[index];
+    };
+    distribution.p50 = at(0.5);
+    distribution.p99 = at(0.99);
+    distribution.max = values.back();
+    return distribution;
+}
+
+struct ClockSource {
+    const char *name;
+    // returns some reading of the clock, only used to stop the compiler from optimizing the read away
+    std::uint64_t (*read)();
+};
+
+std::vector<ClockSource> get_clock_sources() {
+    std::vector<ClockSource> clock_sources = {
+        {"steady_clock",
+         [] { return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()); }},
+        {"system_clock",
+         [] { return static_cast<std::uint64_t>(std::chrono::system_clock::now().time_since_epoch().count()); }},
+    };
+#ifdef __linux__
+    clock_sources.push_back({"CLOCK_MONOTONIC", [] {
+                                 timespec time;
+                                 clock_gettime(CLOCK_MONOTONIC, &time);
+                                 return static_cast<std::uint64_t>(time.tv_nsec);
+                             }});
+    clock_sources.push_back({"CLOCK_MONOTONIC_COARSE", [] {
+                                 timespec time;
+                                 clock_gettime(CLOCK_MONOTONIC_COARSE, &time);
+                                 return static_cast<std::uint64_t>(time.tv_nsec);
+                             }});
+    clock_sources.push_back({"CLOCK_MONOTONIC_RAW", [] {
+                                 timespec time;
+                                 clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+                                 return static_cast<std::uint64_t>(time.tv_nsec);
+                             }});
+    clock_sources.push_back({"CLOCK_BOOTTIME", [] {
+                                 timespec time;
+                                 clock_gettime(CLOCK_BOOTTIME, &time);
+                                 return static_cast<std::uint64_t>(time.tv_nsec);
+                             }});
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    clock_sources.push_back({"rdtsc", [] { return static_cast<std::uint64_t>(__rdtsc()); }});
+#endif
+    return clock_sources;
+}
+
+/**
+ * @brief the average cost in nanoseconds of reading the clock
+ */
+double measure_clock_read_nanoseconds(const ClockSource &clock_source) {
+    constexpr int read_count = 200000;
+    volatile std::uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < read_count; i++) {
+        sink = sink + clock_source.read();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / read_count;
+}
+
+/**
+ * @brief how much later than requested sleep_for returns, in microseconds
+ */
+Distribution measure_sleep_overshoot_microseconds(std::chrono::microseconds requested) {
+    std::vector<double> overshoots;
+    for (int i = 0; i < 200; i++) {
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(requested);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        overshoots.push_back(std::chrono::duration<double, std::micro>(elapsed - requested).count());
+    }
+    return get_distribution(overshoots);
+}
+
+bool has_cpu_flag(const std::string &flag) {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("flags", 0) == 0) {
+            return (line + " ").find(" " + flag + " ") != std::string::npos;
+        }
+    }
+    return false;
+}
+
+long get_timer_slack_nanoseconds() {
+#ifdef __linux__
+    return static_cast<long>(prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0));
+#else
+    return -1;
+#endif
+}
+
+const char *get_wait_strategy_name(WaitStrategy wait_strategy) {
+    switch (wait_strategy) {
+    case WaitStrategy::busy_poll:
+        return "busy_poll";
+    case WaitStrategy::sleep:
+        return "sleep";
+    case WaitStrategy::hybrid:
+        return "hybrid";
+    }
+    return "unknown";
+}
+
+struct TickAccuracy {
+    WaitStrategy wait_strategy;
+    int cpu;
+    Distribution lateness_microseconds;
+    std::uint64_t missed_signal_count;
+    double cpu_seconds_per_second;
+};
+
+/**
+ * @brief runs a PeriodicSignal with the wait strategy and measures how late each tick was delivered
+ */
+TickAccuracy measure_tick_accuracy(WaitStrategy wait_strategy, int cpu, const Options &options,
+                                   std::chrono::microseconds spin_duration) {
+    PeriodicSignal signal(options.rate_hz);
+    signal.set_poll_statistics_enabled(true);
+    std::vector<double> latenesses;
+    latenesses.reserve(options.tick_count);
+
+    std::clock_t cpu_start = std::clock();
+    auto wall_start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < options.tick_count; tick++) {
+        auto scheduled = signal.get_next_signal_time();
+        signal.wait_for_signal(wait_strategy, spin_duration);
+        latenesses.push_back(
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - scheduled).count());
+    }
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    return {wait_strategy, cpu, get_distribution(latenesses), signal.get_poll_statistics().missed_signal_count,
+            cpu_seconds / wall_seconds};
+}
+
+bool pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+std::vector<int> get_cpus_to_probe(const Options &options) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+        return {-1};
+    }
+    if (!options.all_cpus) {
+        return {sched_getcpu()};
+    }
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &cpu_set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+#else
+    (void)options;
+    return {-1};
+#endif
+}
+
+void print_distribution(const char *name, const Distribution &distribution) {
+    std::printf("\"%s\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}", name, distribution.p50, distribution.p99,
+                distribution.max);
+}
+
+Options parse_options(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            options.rate_hz = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            options.tick_count = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--all-cpus") == 0) {
+            options.all_cpus = true;
+        } else {
+            std::fprintf(stderr, "usage: %s [--rate HZ] [--ticks N] [--all-cpus]\n", argv[0]);
+            std::exit(1);
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options = parse_options(argc, argv);
+
+    std::printf("{\n");
+
+    // clock sources
+    std::vector<ClockSource> clock_sources = get_clock_sources();
+    const char *recommended_clock_source = "steady_clock";
+    double cheapest_read_nanoseconds = 1e9;
+    std::printf("  \"clock_read_ns\": {");
+    for (std::size_t i = 0; i < clock_sources.size(); i++) {
+        double read_nanoseconds = measure_clock_read_nanoseconds(clock_sources[i]);
+        std::printf("%s\"%s\": %.2f", i == 0 ? "" : ", ", clock_sources[i].name, read_nanoseconds);
+        // the coarse clock is cheap but only ticks every few milliseconds, and rdtsc isn't a time source on its own
+        bool usable = std::strcmp(clock_sources[i].name, "CLOCK_MONOTONIC_COARSE") != 0 &&
+                      std::strcmp(clock_sources[i].name, "rdtsc") != 0 &&
+                      std::strcmp(clock_sources[i].name, "system_clock") != 0;
+        if (usable && read_nanoseconds < cheapest_read_nanoseconds) {
+            cheapest_read_nanoseconds = read_nanoseconds;
+            recommended_clock_source = clock_sources[i].name;
+        }
+    }
+    std::printf("},\n");
+
+    // tsc and timer slack
+    bool invariant_tsc = has_cpu_flag("constant_tsc") && has_cpu_flag("nonstop_tsc");
+    std::printf("  \"invariant_tsc\": %s,\n", invariant_tsc ? "true" : "false");
+    std::printf("  \"timer_slack_ns\": %ld,\n", get_timer_slack_nanoseconds());
+
+    // sleep overshoot
+    const int requested_sleeps_microseconds[] = {0, 50, 100, 1000};
+    Distribution one_millisecond_overshoot;
+    std::printf("  \"sleep_overshoot_us\": {");
+    for (std::size_t i = 0; i < std::size(requested_sleeps_microseconds); i++) {
+        std::chrono::microseconds requested(requested_sleeps_microseconds[i]);
+        Distribution overshoot = measure_sleep_overshoot_microseconds(requested);
+        if (requested_sleeps_microseconds[i] == 1000) {
+            one_millisecond_overshoot = overshoot;
+        }
+        std::string name = "sleep_" + std::to_string(requested_sleeps_microseconds[i]) + "us";
+        std::printf("%s", i == 0 ? "" : ", ");
+        print_distribution(name.c_str(), overshoot);
+    }
+    std::printf("},\n");
+
+    // the hybrid strategy has to spin for at least as long as sleeps usually overshoot
+    auto spin_duration = std::chrono::microseconds(std::max(50, static_cast<int>(one_millisecond_overshoot.p99 * 1.5)));
+
+    // tick accuracy per wait strategy and cpu
+    const WaitStrategy wait_strategies[] = {WaitStrategy::busy_poll, WaitStrategy::sleep, WaitStrategy::hybrid};
+    std::vector<TickAccuracy> tick_accuracies;
+    for (int cpu : get_cpus_to_probe(options)) {
+        if (options.all_cpus && !pin_to_cpu(cpu)) {
+            continue;
+        }
+        for (WaitStrategy wait_strategy : wait_strategies) {
+            tick_accuracies.push_back(measure_tick_accuracy(wait_strategy, cpu, options, spin_duration));
+        }
+    }
+
+    std::printf("  \"tick_accuracy\": {\"rate_hz\": %d, \"ticks\": %d, \"results\": [\n", options.rate_hz,
+                options.tick_count);
+    for (std::size_t i = 0; i < tick_accuracies.size(); i++) {
+        const TickAccuracy &accuracy = tick_accuracies[i];
+        std::printf("    {\"wait_strategy\": \"%s\", \"cpu\": %d, ", get_wait_strategy_name(accuracy.wait_strategy),
+                    accuracy.cpu);
+        print_distribution("lateness_us", accuracy.lateness_microseconds);
+        std::printf(", \"missed_ticks\": %llu, \"cpu_utilization\": %.3f}%s\n",
+                    static_cast<unsigned long long>(accuracy.missed_signal_count), accuracy.cpu_seconds_per_second,
+                    i + 1 == tick_accuracies.size() ? "" : ",");
+    }
+    std::printf("  ]},\n");
+
+    // pick the cheapest wait strategy whose worst cpu still keeps p99 lateness under 5% of the period
+    double period_microseconds = 1e6 / options.rate_hz;
+    double lateness_budget_microseconds = period_microseconds * 0.05;
+    WaitStrategy recommended_wait_strategy = WaitStrategy::busy_poll;
+    for (WaitStrategy wait_strategy : {WaitStrategy::sleep, WaitStrategy::hybrid}) {
+        double worst_p99 = 0;
+        for (const TickAccuracy &accuracy : tick_accuracies) {
+            if (accuracy.wait_strategy == wait_strategy) {
+                worst_p99 = std::max(worst_p99, accuracy.lateness_microseconds.p99);
+            }
+        }
+        if (worst_p99 <= lateness_budget_microseconds) {
+            recommended_wait_strategy = wait_strategy;
+            break;
+        }
+    }
+
+    std::printf("  \"recommended\": {\"clock_source\": \"%s\", \"wait_strategy\": \"%s\", \"hybrid_spin_us\": %lld}\n",
+                recommended_clock_source, get_wait_strategy_name(recommended_wait_strategy),
+                static_cast<long long>(spin_duration.count()));
+    std::printf("}\n");
+    return 0;
+}
@@ -0,0 +1,342 @@
+/**
+ * @brief tick_sync_loopback runs a TickSyncServer and TickSyncClient against each other over loopback udp and checks
+ * that the client converges on the server's timeline
+ *
+ * @details the server runs on its own thread and pretends its steady clock is ahead of the client's by a fixed offset.
+ * Every request is held back by the simulated one way latency plus exponentially distributed jitter before the server
+ * stamps it as received, and every response is held back the same way after the server stamps it as sent, with the
+ * occasional much larger outlier delay thrown in. Every packet is delayed on its own, so a slow one doesn't hold up
+ * the ones behind it, and the client sees the kind of round trips a real link gives.
+ *
+ * the client starts far away from the server's timeline and runs three phases
+ *  - converge: it has to resync exactly once and then settle close to where it should be
+ *  - slew: its timeline is nudged by less than the resync threshold, which has to be fixed by slewing alone
+ *  - resync: its timeline is knocked back by more than the resync threshold, which has to be fixed by one resync
+ *
+ * at the end of every phase the estimated clock offset has to be within the tolerance of the simulated one and the
+ * timeline error has to be small. The report is printed as json to stdout, and the exit code is 0 if every check
+ * passed.
+ *
+ * build: g++ -std=c++17 -O2 -I.. tick_sync_loopback.cpp -o tick_sync_loopback -pthread
+ *
+ * usage: tick_sync_loopback [--rate HZ] [--latency-ms MS] [--jitter-ms MS] [--offset-ms MS] [--phase-seconds S]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "periodic_signal.hpp"
+#include "tick_sync.hpp"
+
+namespace {
+
+struct Options {
+    int rate_hz = 60;
+    double latency_milliseconds = 10;
+    double jitter_milliseconds = 2;
+    double offset_milliseconds = 5000;
+    double phase_seconds = 3;
+};
+
+Options parse_options(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            options.rate_hz = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc) {
+            options.latency_milliseconds = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--jitter-ms") == 0 && i + 1 < argc) {
+            options.jitter_milliseconds = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--offset-ms") == 0 && i + 1 < argc) {
+            options.offset_milliseconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--phase-seconds") == 0 && i + 1 < argc) {
+            options.phase_seconds = std::max(0.5, std::atof(argv[++i]));
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--rate HZ] [--latency-ms MS] [--jitter-ms MS] [--offset-ms MS] "
+                         "[--phase-seconds S]\n",
+                         argv[0]);
+            std::exit(1);
+        }
+    }
+    return options;
+}
+
+/**
+ * @brief the delay of one trip across the simulated link
+ */
+class SimulatedLink {
+  public:
+    SimulatedLink(double latency_milliseconds, double jitter_milliseconds, std::uint32_t seed)
+        : latency_milliseconds(latency_milliseconds), random(seed),
+          jitter(jitter_milliseconds > 0 ? 1.0 / jitter_milliseconds : 1.0),
+          has_jitter(jitter_milliseconds > 0) {}
+
+    std::chrono::duration<double, std::milli> get_delay() {
+        double delay_milliseconds = latency_milliseconds;
+        if (has_jitter) {
+            delay_milliseconds += jitter(random);
+        }
+        // one trip in twenty sits in a queue somewhere
+        if (std::uniform_int_distribution<int>(0, 19)(random) == 0) {
+            delay_milliseconds += 5 * latency_milliseconds + 20;
+        }
+        return std::chrono::duration<double, std::milli>(delay_milliseconds);
+    }
+
+  private:
+    double latency_milliseconds;
+    std::mt19937 random;
+    std::exponential_distribution<double> jitter;
+    bool has_jitter;
+};
+
+/**
+ * @brief answers tick sync requests on a loopback socket, with a clock that runs offset from the real one
+ */
+class LoopbackServer {
+  public:
+    explicit LoopbackServer(const Options &options)
+        : signal(options.rate_hz), tick_sync_server(signal), link(options.latency_milliseconds,
+                                                                   options.jitter_milliseconds, 1),
+          clock_offset(std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::duration<double, std::milli>(options.offset_milliseconds))) {
+        socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        bind(socket_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+        socklen_t length = sizeof(bound_address);
+        getsockname(socket_fd, reinterpret_cast<sockaddr *>(&bound_address), &length);
+        // put the server somewhere on its timeline which has nothing to do with where the client starts
+        signal.set_timeline_position(100000, 0.3);
+    }
+
+    ~LoopbackServer() {
+        running = false;
+        if (thread.joinable()) {
+            thread.join();
+        }
+        close(socket_fd);
+    }
+
+    void start() {
+        running = true;
+        thread = std::thread([this] { serve(); });
+    }
+
+    const sockaddr_in &get_address() const { return bound_address; }
+
+    double get_clock_offset_seconds() const { return std::chrono::duration<double>(clock_offset).count(); }
+
+  private:
+    PeriodicSignal signal;
+    TickSyncServer tick_sync_server;
+    SimulatedLink link;
+    std::chrono::nanoseconds clock_offset;
+    int socket_fd = -1;
+    sockaddr_in bound_address{};
+    std::atomic<bool> running{false};
+    std::thread thread;
+
+    struct InFlightRequest {
+        std::chrono::steady_clock::time_point arrival_time;
+        TickSyncRequest request;
+        sockaddr_in client_address;
+    };
+
+    struct InFlightResponse {
+        std::chrono::steady_clock::time_point arrival_time;
+        TickSyncResponse response;
+        sockaddr_in client_address;
+    };
+
+    void serve() {
+        std::vector<InFlightRequest> in_flight_requests;
+        std::vector<InFlightResponse> in_flight_responses;
+        while (running) {
+            auto now = std::chrono::steady_clock::now();
+
+            // requests that have made it across the link are answered right away
+            for (std::size_t i = 0; i < in_flight_requests.size();) {
+                if (in_flight_requests[i].arrival_time > now) {
+                    i++;
+                    continue;
+                }
+                auto receive_time = std::chrono::steady_clock::now();
+                TickSyncResponse response = tick_sync_server.respond(in_flight_requests[i].request, receive_time);
+                // the server's clock is ahead of the client's, the timeline position stays the same
+                response.server_receive_time += clock_offset.count();
+                response.server_send_time += clock_offset.count();
+                auto arrival_time = std::chrono::steady_clock::now() + get_link_delay();
+                in_flight_responses.push_back({arrival_time, response, in_flight_requests[i].client_address});
+                in_flight_requests[i] = in_flight_requests.back();
+                in_flight_requests.pop_back();
+            }
+
+            for (std::size_t i = 0; i < in_flight_responses.size();) {
+                if (in_flight_responses[i].arrival_time > now) {
+                    i++;
+                    continue;
+                }
+                sendto(socket_fd, &in_flight_responses[i].response, sizeof(TickSyncResponse), 0,
+                       reinterpret_cast<const sockaddr *>(&in_flight_responses[i].client_address), sizeof(sockaddr_in));
+                in_flight_responses[i] = in_flight_responses.back();
+                in_flight_responses.pop_back();
+            }
+
+            // sleep until the next packet arrives at either end or a new request comes in
+            auto wake_time = now + std::chrono::milliseconds(50);
+            for (const InFlightRequest &in_flight : in_flight_requests) {
+                wake_time = std::min(wake_time, in_flight.arrival_time);
+            }
+            for (const InFlightResponse &in_flight : in_flight_responses) {
+                wake_time = std::min(wake_time, in_flight.arrival_time);
+            }
+            auto timeout_nanoseconds = std::max<std::int64_t>(
+                0, std::chrono::duration_cast<std::chrono::nanoseconds>(wake_time - now).count());
+            timespec timeout{static_cast<time_t>(timeout_nanoseconds / 1000000000),
+                             static_cast<long>(timeout_nanoseconds % 1000000000)};
+            pollfd socket_poll{socket_fd, POLLIN, 0};
+            if (::ppoll(&socket_poll, 1, &timeout, nullptr) <= 0) {
+                continue;
+            }
+
+            InFlightRequest in_flight;
+            socklen_t client_address_length = sizeof(in_flight.client_address);
+            while (recvfrom(socket_fd, &in_flight.request, sizeof(in_flight.request), MSG_DONTWAIT,
+                            reinterpret_cast<sockaddr *>(&in_flight.client_address),
+                            &client_address_length) == sizeof(in_flight.request)) {
+                // the request is still on its way
+                in_flight.arrival_time = std::chrono::steady_clock::now() + get_link_delay();
+                in_flight_requests.push_back(in_flight);
+                client_address_length = sizeof(in_flight.client_address);
+            }
+        }
+    }
+
+    std::chrono::steady_clock::duration get_link_delay() {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(link.get_delay());
+    }
+};
+
+struct PhaseResult {
+    const char *name;
+    std::uint64_t slew_count;
+    std::uint64_t resync_count;
+    double offset_error_milliseconds;
+    double timeline_error_ticks;
+    bool passed;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options = parse_options(argc, argv);
+
+    LoopbackServer server(options);
+    server.start();
+
+    int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    connect(socket_fd, reinterpret_cast<const sockaddr *>(&server.get_address()), sizeof(sockaddr_in));
+
+    PeriodicSignal signal(options.rate_hz);
+    TickSyncClient client;
+    const double resync_threshold_ticks = 2.0;
+    // the offset estimate can't be better than the asymmetry of the delays of the round trips it's made from
+    const double offset_tolerance_milliseconds = std::max(1.0, options.jitter_milliseconds);
+    const double timeline_tolerance_ticks = 0.25;
+    const auto request_interval = std::chrono::milliseconds(50);
+
+    auto run_phase = [&](const char *name, std::uint64_t expected_resync_count, bool expect_slews) {
+        TickSyncClient::Statistics statistics_before = client.get_statistics();
+        auto phase_end_time =
+            std::chrono::steady_clock::now() + std::chrono::duration<double>(options.phase_seconds);
+        auto next_request_time = std::chrono::steady_clock::now();
+
+        while (std::chrono::steady_clock::now() < phase_end_time) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_request_time) {
+                TickSyncRequest request = client.create_request(now);
+                send(socket_fd, &request, sizeof(request), 0);
+                next_request_time += request_interval;
+            }
+
+            TickSyncResponse response;
+            while (recv(socket_fd, &response, sizeof(response), MSG_DONTWAIT) == sizeof(response)) {
+                client.handle_response(response, std::chrono::steady_clock::now());
+            }
+
+            if (signal.process_and_get_signal()) {
+                client.synchronize(signal);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        const TickSyncClient::Statistics &statistics = client.get_statistics();
+        PhaseResult result;
+        result.name = name;
+        result.slew_count = statistics.slew_count - statistics_before.slew_count;
+        result.resync_count = statistics.resync_count - statistics_before.resync_count;
+        result.offset_error_milliseconds = (client.get_offset_seconds() - server.get_clock_offset_seconds()) * 1e3;
+        result.timeline_error_ticks = client.get_timeline_error_ticks(signal, std::chrono::steady_clock::now());
+        result.passed = result.resync_count == expected_resync_count && (!expect_slews || result.slew_count > 0) &&
+                        std::abs(result.offset_error_milliseconds) <= offset_tolerance_milliseconds &&
+                        std::abs(result.timeline_error_ticks) <= timeline_tolerance_ticks;
+        return result;
+    };
+
+    // start far away from the server's timeline, so the first adjustment has to be a resync
+    PhaseResult results[3];
+    results[0] = run_phase("converge", 1, false);
+
+    // a nudge below the resync threshold has to be slewed away
+    signal.advance_timeline(std::chrono::duration<double>(0.5 * signal.get_period_seconds()));
+    results[1] = run_phase("slew", 0, true);
+
+    // a jump beyond the resync threshold has to be fixed in one go
+    signal.advance_timeline(std::chrono::duration<double>(-(resync_threshold_ticks + 3) * signal.get_period_seconds()));
+    results[2] = run_phase("resync", 1, false);
+
+    close(socket_fd);
+
+    bool passed = true;
+    std::printf("{\n");
+    std::printf("  \"rate_hz\": %d, \"latency_ms\": %.2f, \"jitter_ms\": %.2f, \"offset_ms\": %.2f,\n",
+                options.rate_hz, options.latency_milliseconds, options.jitter_milliseconds,
+                options.offset_milliseconds);
+    std::printf("  \"estimated_rtt_ms\": %.3f, \"estimated_jitter_ms\": %.3f, \"outliers\": %llu,\n",
+                client.get_rtt_seconds() * 1e3, client.get_jitter_seconds() * 1e3,
+                static_cast<unsigned long long>(client.get_statistics().outlier_count));
+    std::printf("  \"phases\": [\n");
+    for (std::size_t i = 0; i < std::size(results); i++) {
+        const PhaseResult &result = results[i];
+        passed = passed && result.passed;
+        std::printf("    {\"name\": \"%s\", \"slews\": %llu, \"resyncs\": %llu, \"offset_error_ms\": %.3f, "
+                    "\"timeline_error_ticks\": %.4f, \"passed\": %s}%s\n",
+                    result.name, static_cast<unsigned long long>(result.slew_count),
+                    static_cast<unsigned long long>(result.resync_count), result.offset_error_milliseconds,
+                    result.timeline_error_ticks, result.passed ? "true" : "false",
+                    i + 1 < std::size(results) ? "," : "");
+    }
+    std::printf("  ],\n");
+    std::printf("  \"passed\": %s\n", passed ? "true" : "false");
+    std::printf("}\n");
+    return passed ? 0 : 1;
+}